@@ -0,0 +1,606 @@
+/*
+* Baked texture container
+*
+* GPU ready texture files (.vkt) that are uploaded without decoding: a header, a table of payloads,
+* optional sprite frames and the payload data. Every payload stores all layers and mip levels of the
+* texture in one format, layer major and tightly packed, so the memory mapped file is copied to the
+* staging buffer as is. Bakers put compressed payloads first and RGBA8 last, the loader picks the
+* first one the device can sample from.
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "TextureAtlas.hpp"
+#include "VulkanTexture.hpp"
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif !defined(__ANDROID__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace vks {
+namespace baked {
+
+const uint32_t magic = 0x544b5456; // "VTKT"
+const uint32_t version = 1;
+
+struct Header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t layerCount;
+    uint32_t mipLevels;
+    uint32_t payloadCount;
+    uint32_t frameCount;
+};
+
+// Followed by frameCount sprite frames (TextureAtlas::Frame), payload offsets are relative to the start of the file
+struct Payload {
+    uint32_t format;
+    uint32_t reserved;
+    uint64_t offset;
+    uint64_t size;
+};
+
+struct PayloadData {
+    VkFormat format;
+    std::vector<uint8_t> data;
+};
+
+// Texel block dimensions and size, uncompressed formats use 1x1 blocks
+struct FormatBlock {
+    uint32_t width;
+    uint32_t height;
+    uint32_t bytes;
+};
+
+/** @brief Block layout of the formats a payload may use, false for anything else */
+inline bool formatBlock(VkFormat format, FormatBlock& block)
+{
+    switch (format) {
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+        block = { 1, 1, 4 };
+        return true;
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+    case VK_FORMAT_ASTC_4x4_UNORM_BLOCK:
+    case VK_FORMAT_ASTC_4x4_SRGB_BLOCK:
+        block = { 4, 4, 16 };
+        return true;
+    case VK_FORMAT_ASTC_6x6_UNORM_BLOCK:
+    case VK_FORMAT_ASTC_6x6_SRGB_BLOCK:
+        block = { 6, 6, 16 };
+        return true;
+    case VK_FORMAT_ASTC_8x8_UNORM_BLOCK:
+    case VK_FORMAT_ASTC_8x8_SRGB_BLOCK:
+        block = { 8, 8, 16 };
+        return true;
+    default:
+        return false;
+    }
+}
+
+inline uint64_t levelSize(const FormatBlock& block, uint32_t width, uint32_t height, uint32_t level)
+{
+    uint64_t w = std::max(1u, width >> level);
+    uint64_t h = std::max(1u, height >> level);
+    return ((w + block.width - 1) / block.width) * ((h + block.height - 1) / block.height) * block.bytes;
+}
+
+inline uint64_t payloadSize(const FormatBlock& block, const Header& header)
+{
+    uint64_t size = 0;
+    for (uint32_t level = 0; level < header.mipLevels; level++) {
+        size += levelSize(block, header.width, header.height, level);
+    }
+    return size * header.layerCount;
+}
+
+inline const char* formatName(VkFormat format)
+{
+    switch (format) {
+    case VK_FORMAT_R8G8B8A8_UNORM: case VK_FORMAT_R8G8B8A8_SRGB: return "RGBA8";
+    case VK_FORMAT_BC7_UNORM_BLOCK: case VK_FORMAT_BC7_SRGB_BLOCK: return "BC7";
+    case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK: case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK: return "ETC2";
+    default: return "ASTC";
+    }
+}
+
+/** @brief Read only memory mapping of a file, Android assets are opened as buffers (mapped when stored uncompressed in the APK) */
+class MappedFile {
+public:
+    MappedFile() {}
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& filename)
+    {
+        close();
+#if defined(__ANDROID__)
+        asset = AAssetManager_open(androidApp->activity->assetManager, filename.c_str(), AASSET_MODE_BUFFER);
+        if (asset) {
+            mapped = AAsset_getBuffer(asset);
+            length = (size_t)AAsset_getLength(asset);
+        }
+#elif defined(_WIN32)
+        file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file != INVALID_HANDLE_VALUE) {
+            LARGE_INTEGER fileSize;
+            GetFileSizeEx(file, &fileSize);
+            length = (size_t)fileSize.QuadPart;
+            mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (mapping) {
+                mapped = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            }
+        }
+#else
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd >= 0) {
+            struct stat info;
+            if (fstat(fd, &info) == 0 && info.st_size > 0) {
+                length = (size_t)info.st_size;
+                void* ptr = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (ptr != MAP_FAILED) {
+                    // The whole file is copied to staging right away
+                    madvise(ptr, length, MADV_WILLNEED);
+                    mapped = ptr;
+                }
+            }
+            ::close(fd);
+        }
+#endif
+        if (!mapped) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close()
+    {
+#if defined(__ANDROID__)
+        if (asset) {
+            AAsset_close(asset);
+            asset = nullptr;
+        }
+#elif defined(_WIN32)
+        if (mapped) {
+            UnmapViewOfFile(mapped);
+        }
+        if (mapping) {
+            CloseHandle(mapping);
+            mapping = nullptr;
+        }
+        if (file != INVALID_HANDLE_VALUE) {
+            CloseHandle(file);
+            file = INVALID_HANDLE_VALUE;
+        }
+#else
+        if (mapped) {
+            munmap((void*)mapped, length);
+        }
+#endif
+        mapped = nullptr;
+        length = 0;
+    }
+
+    const uint8_t* data() const { return (const uint8_t*)mapped; }
+    size_t size() const { return length; }
+
+private:
+    const void* mapped = nullptr;
+    size_t length = 0;
+#if defined(__ANDROID__)
+    AAsset* asset = nullptr;
+#elif defined(_WIN32)
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#endif
+};
+
+namespace detail {
+
+// Appends count bits of value to a 128 bit block, least significant bit first
+inline void putBits(uint8_t* block, uint32_t& bit, uint32_t value, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++, bit++) {
+        block[bit >> 3] |= (uint8_t)(((value >> i) & 1) << (bit & 7));
+    }
+}
+
+// Principal axis fit through channels [first, first + count) of the texels, lo and hi receive the ends at the extreme projections
+inline void fitLine(const uint8_t texels[16][4], uint32_t first, uint32_t count, float lo[4], float hi[4])
+{
+    float mean[4] = { 0.f, 0.f, 0.f, 0.f };
+    for (uint32_t t = 0; t < 16; t++) {
+        for (uint32_t c = first; c < first + count; c++) {
+            mean[c] += texels[t][c] / 16.f;
+        }
+    }
+    float covariance[4][4] = {};
+    for (uint32_t t = 0; t < 16; t++) {
+        for (uint32_t i = first; i < first + count; i++) {
+            for (uint32_t j = first; j < first + count; j++) {
+                covariance[i][j] += (texels[t][i] - mean[i]) * (texels[t][j] - mean[j]);
+            }
+        }
+    }
+    float axis[4] = { 1.f, 1.f, 1.f, 1.f };
+    for (uint32_t iteration = 0; iteration < 8; iteration++) {
+        float next[4] = { 0.f, 0.f, 0.f, 0.f };
+        float length = 0.f;
+        for (uint32_t i = first; i < first + count; i++) {
+            for (uint32_t j = first; j < first + count; j++) {
+                next[i] += covariance[i][j] * axis[j];
+            }
+            length = std::max(length, fabsf(next[i]));
+        }
+        if (length == 0.f) {
+            break;
+        }
+        for (uint32_t i = first; i < first + count; i++) {
+            axis[i] = next[i] / length;
+        }
+    }
+    float minT = 0.f, maxT = 0.f, axisLength = 0.f;
+    for (uint32_t t = 0; t < 16; t++) {
+        float d = 0.f;
+        for (uint32_t c = first; c < first + count; c++) {
+            d += (texels[t][c] - mean[c]) * axis[c];
+        }
+        minT = std::min(minT, d);
+        maxT = std::max(maxT, d);
+    }
+    for (uint32_t c = first; c < first + count; c++) {
+        axisLength += axis[c] * axis[c];
+    }
+    for (uint32_t c = first; c < first + count; c++) {
+        float scale = axisLength > 0.f ? axis[c] / axisLength : 0.f;
+        lo[c] = std::min(std::max(mean[c] + scale * minT, 0.f), 255.f);
+        hi[c] = std::min(std::max(mean[c] + scale * maxT, 0.f), 255.f);
+    }
+}
+
+// Picks the interpolation weight closest to every texel over channels [first, first + count), returns the squared error
+template<uint32_t WeightCount>
+inline uint32_t selectIndices(const uint8_t texels[16][4], const int endpoints[2][4], const int (&weights)[WeightCount], uint32_t first, uint32_t count, uint32_t indices[16])
+{
+    uint32_t total = 0;
+    for (uint32_t t = 0; t < 16; t++) {
+        uint32_t bestError = UINT32_MAX;
+        for (uint32_t i = 0; i < WeightCount; i++) {
+            uint32_t error = 0;
+            for (uint32_t c = first; c < first + count; c++) {
+                int v = ((64 - weights[i]) * endpoints[0][c] + weights[i] * endpoints[1][c] + 32) >> 6;
+                error += (v - texels[t][c]) * (v - texels[t][c]);
+            }
+            if (error < bestError) {
+                bestError = error;
+                indices[t] = i;
+            }
+        }
+        total += bestError;
+    }
+    return total;
+}
+
+// The highest index bit of the first texel is implicitly zero, swapping the endpoints mirrors the indices (the weights are symmetric)
+inline void fixAnchor(uint32_t quantized[2][4], uint32_t first, uint32_t count, uint32_t indices[16], uint32_t indexCount)
+{
+    if (indices[0] < indexCount / 2) {
+        return;
+    }
+    for (uint32_t c = first; c < first + count; c++) {
+        std::swap(quantized[0][c], quantized[1][c]);
+    }
+    for (uint32_t t = 0; t < 16; t++) {
+        indices[t] = indexCount - 1 - indices[t];
+    }
+}
+
+// Mode 6: one RGBA line with 7 bit endpoints plus a shared lowest bit per endpoint and 4 bit indices
+inline uint32_t encodeMode6(const uint8_t texels[16][4], uint8_t* block)
+{
+    static const int weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+    float line[2][4];
+    fitLine(texels, 0, 4, line[0], line[1]);
+
+    uint32_t quantized[2][4], pbit[2] = { 0, 0 };
+    int endpoints[2][4];
+    for (uint32_t e = 0; e < 2; e++) {
+        uint32_t bestError = UINT32_MAX;
+        for (uint32_t p = 0; p < 2; p++) {
+            uint32_t q[4], error = 0;
+            for (uint32_t c = 0; c < 4; c++) {
+                q[c] = (uint32_t)std::min(std::max((line[e][c] - p) * 0.5f + 0.5f, 0.f), 127.f);
+                int d = (int)((q[c] << 1) | p) - (int)(line[e][c] + 0.5f);
+                error += d * d;
+            }
+            if (error < bestError) {
+                bestError = error;
+                pbit[e] = p;
+                memcpy(quantized[e], q, sizeof(q));
+            }
+        }
+        for (uint32_t c = 0; c < 4; c++) {
+            endpoints[e][c] = (int)((quantized[e][c] << 1) | pbit[e]);
+        }
+    }
+    uint32_t indices[16];
+    uint32_t error = selectIndices(texels, endpoints, weights, 0, 4, indices);
+    if (indices[0] >= 8) {
+        std::swap(pbit[0], pbit[1]);
+    }
+    fixAnchor(quantized, 0, 4, indices, 16);
+
+    memset(block, 0, 16);
+    uint32_t bit = 0;
+    putBits(block, bit, 1 << 6, 7);
+    for (uint32_t c = 0; c < 4; c++) {
+        putBits(block, bit, quantized[0][c], 7);
+        putBits(block, bit, quantized[1][c], 7);
+    }
+    putBits(block, bit, pbit[0], 1);
+    putBits(block, bit, pbit[1], 1);
+    for (uint32_t t = 0; t < 16; t++) {
+        putBits(block, bit, indices[t], t == 0 ? 3 : 4);
+    }
+    assert(bit == 128);
+    return error;
+}
+
+// Mode 5: an RGB line with 7 bit endpoints and an 8 bit alpha range, each with their own 2 bit indices
+inline uint32_t encodeMode5(const uint8_t texels[16][4], uint8_t* block)
+{
+    static const int weights[4] = { 0, 21, 43, 64 };
+    float line[2][4];
+    fitLine(texels, 0, 3, line[0], line[1]);
+    line[0][3] = 255.f;
+    line[1][3] = 0.f;
+    for (uint32_t t = 0; t < 16; t++) {
+        line[0][3] = std::min(line[0][3], (float)texels[t][3]);
+        line[1][3] = std::max(line[1][3], (float)texels[t][3]);
+    }
+
+    uint32_t quantized[2][4];
+    int endpoints[2][4];
+    for (uint32_t e = 0; e < 2; e++) {
+        for (uint32_t c = 0; c < 3; c++) {
+            quantized[e][c] = (uint32_t)(line[e][c] * 127.f / 255.f + 0.5f);
+            endpoints[e][c] = (int)((quantized[e][c] << 1) | (quantized[e][c] >> 6));
+        }
+        quantized[e][3] = (uint32_t)line[e][3];
+        endpoints[e][3] = (int)quantized[e][3];
+    }
+    uint32_t colorIndices[16], alphaIndices[16];
+    uint32_t error = selectIndices(texels, endpoints, weights, 0, 3, colorIndices) + selectIndices(texels, endpoints, weights, 3, 1, alphaIndices);
+    fixAnchor(quantized, 0, 3, colorIndices, 4);
+    fixAnchor(quantized, 3, 1, alphaIndices, 4);
+
+    memset(block, 0, 16);
+    uint32_t bit = 0;
+    putBits(block, bit, 1 << 5, 6);
+    putBits(block, bit, 0, 2);
+    for (uint32_t c = 0; c < 3; c++) {
+        putBits(block, bit, quantized[0][c], 7);
+        putBits(block, bit, quantized[1][c], 7);
+    }
+    putBits(block, bit, quantized[0][3], 8);
+    putBits(block, bit, quantized[1][3], 8);
+    for (uint32_t t = 0; t < 16; t++) {
+        putBits(block, bit, colorIndices[t], t == 0 ? 1 : 2);
+    }
+    for (uint32_t t = 0; t < 16; t++) {
+        putBits(block, bit, alphaIndices[t], t == 0 ? 1 : 2);
+    }
+    assert(bit == 128);
+    return error;
+}
+
+// Encodes a block with whichever of the single subset modes 5 and 6 fits it better
+inline void encodeBC7Block(const uint8_t texels[16][4], uint8_t* block)
+{
+    uint8_t candidate[16];
+    if (encodeMode5(texels, candidate) < encodeMode6(texels, block)) {
+        memcpy(block, candidate, 16);
+    }
+}
+}
+
+/** @brief Encodes one RGBA8 image to BC7 blocks appended to out, partial blocks at the edges repeat the last row and column */
+inline void encodeBC7(const uint8_t* pixels, uint32_t width, uint32_t height, std::vector<uint8_t>& out)
+{
+    uint8_t texels[16][4];
+    for (uint32_t by = 0; by < height; by += 4) {
+        for (uint32_t bx = 0; bx < width; bx += 4) {
+            for (uint32_t t = 0; t < 16; t++) {
+                uint32_t x = std::min(bx + (t & 3), width - 1);
+                uint32_t y = std::min(by + (t >> 2), height - 1);
+                memcpy(texels[t], pixels + ((size_t)y * width + x) * 4, 4);
+            }
+            size_t offset = out.size();
+            out.resize(offset + 16);
+            detail::encodeBC7Block(texels, out.data() + offset);
+        }
+    }
+}
+
+/** @brief Encodes RGBA8 texel data laid out like a payload (layer major, each layer followed by its mip levels) to a BC7 payload */
+inline std::vector<uint8_t> encodeBC7(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t layerCount, uint32_t mipLevels)
+{
+    std::vector<uint8_t> out;
+    for (uint32_t layer = 0; layer < layerCount; layer++) {
+        for (uint32_t level = 0; level < mipLevels; level++) {
+            uint32_t w = std::max(1u, width >> level);
+            uint32_t h = std::max(1u, height >> level);
+            encodeBC7(pixels, w, h, out);
+            pixels += (size_t)w * h * 4;
+        }
+    }
+    return out;
+}
+
+/**
+* Writes a baked texture file
+*
+* @param payloads Texel data of the texture in one or more formats, in order of preference
+* @param frames Sprite frames stored with an atlas, may be empty
+* @return False if the file could not be written or a payload doesn't match the texture dimensions
+*/
+inline bool write(const std::string& filename, uint32_t width, uint32_t height, uint32_t layerCount, uint32_t mipLevels,
+    const std::vector<PayloadData>& payloads, const std::vector<TextureAtlas::Frame>& frames)
+{
+    Header header = { magic, version, width, height, layerCount, mipLevels, (uint32_t)payloads.size(), (uint32_t)frames.size() };
+    // Payloads start on 16 byte boundaries, a multiple of every block size
+    uint64_t offset = sizeof(Header) + payloads.size() * sizeof(Payload) + frames.size() * sizeof(TextureAtlas::Frame);
+    std::vector<Payload> table(payloads.size());
+    for (size_t i = 0; i < payloads.size(); i++) {
+        FormatBlock block;
+        if (!formatBlock(payloads[i].format, block) || payloads[i].data.size() != payloadSize(block, header)) {
+            return false;
+        }
+        offset = (offset + 15) & ~(uint64_t)15;
+        table[i].format = (uint32_t)payloads[i].format;
+        table[i].reserved = 0;
+        table[i].offset = offset;
+        table[i].size = payloads[i].data.size();
+        offset += table[i].size;
+    }
+
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    file.write((const char*)&header, sizeof(Header));
+    file.write((const char*)table.data(), table.size() * sizeof(Payload));
+    file.write((const char*)frames.data(), frames.size() * sizeof(TextureAtlas::Frame));
+    for (size_t i = 0; i < payloads.size(); i++) {
+        const char padding[16] = {};
+        file.write(padding, table[i].offset - (uint64_t)file.tellp());
+        file.write((const char*)payloads[i].data.data(), payloads[i].data.size());
+    }
+    return file.good();
+}
+
+/** @brief Payload of a baked file selected for a device, with one copy region per layer and mip level */
+struct Selection {
+    Header header;
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    // Points into the mapped file
+    const uint8_t* data = nullptr;
+    uint64_t size = 0;
+    std::vector<VkBufferImageCopy> regions;
+    std::vector<TextureAtlas::Frame> frames;
+};
+
+/**
+* Validates a mapped baked file and selects the first payload whose format supports sampling with linear filtering on the device
+*
+* @param viewType VK_IMAGE_VIEW_TYPE_2D for single layer textures or VK_IMAGE_VIEW_TYPE_2D_ARRAY
+* @note Only queries device properties, may be called from worker threads
+* @return False if the file is invalid or has no usable payload
+*/
+inline bool select(const MappedFile& file, VkImageViewType viewType, vks::VulkanDevice* device, Selection& selection)
+{
+    if (file.size() < sizeof(Header)) {
+        return false;
+    }
+    Header& header = selection.header;
+    memcpy(&header, file.data(), sizeof(Header));
+    const uint64_t tableEnd = sizeof(Header) + (uint64_t)header.payloadCount * sizeof(Payload) + (uint64_t)header.frameCount * sizeof(TextureAtlas::Frame);
+    if (header.magic != magic || header.version != version || tableEnd > file.size() || header.layerCount == 0 || header.mipLevels == 0 ||
+        (viewType == VK_IMAGE_VIEW_TYPE_2D && header.layerCount != 1)) {
+        return false;
+    }
+    const VkPhysicalDeviceLimits& limits = device->properties.limits;
+    if (std::max(header.width, header.height) > limits.maxImageDimension2D || header.layerCount > limits.maxImageArrayLayers) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < header.payloadCount; i++) {
+        Payload payload;
+        memcpy(&payload, file.data() + sizeof(Header) + i * sizeof(Payload), sizeof(Payload));
+        VkFormat format = (VkFormat)payload.format;
+        FormatBlock block;
+        if (!formatBlock(format, block) || payload.size != payloadSize(block, header) || payload.offset + payload.size > file.size()) {
+            continue;
+        }
+        VkFormatProperties formatProperties;
+        vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
+        const VkFormatFeatureFlags required = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+        if ((formatProperties.optimalTilingFeatures & required) != required) {
+            continue;
+        }
+
+        selection.regions.clear();
+        VkDeviceSize offset = 0;
+        for (uint32_t layer = 0; layer < header.layerCount; layer++) {
+            for (uint32_t level = 0; level < header.mipLevels; level++) {
+                VkBufferImageCopy region = {};
+                region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                region.imageSubresource.mipLevel = level;
+                region.imageSubresource.baseArrayLayer = layer;
+                region.imageSubresource.layerCount = 1;
+                region.imageExtent.width = std::max(1u, header.width >> level);
+                region.imageExtent.height = std::max(1u, header.height >> level);
+                region.imageExtent.depth = 1;
+                region.bufferOffset = offset;
+                selection.regions.push_back(region);
+                offset += levelSize(block, header.width, header.height, level);
+            }
+        }
+        selection.format = format;
+        selection.data = file.data() + payload.offset;
+        selection.size = payload.size;
+        selection.frames.resize(header.frameCount);
+        memcpy(selection.frames.data(), file.data() + sizeof(Header) + header.payloadCount * sizeof(Payload), selection.frames.size() * sizeof(TextureAtlas::Frame));
+        return true;
+    }
+    return false;
+}
+
+/**
+* Loads a baked texture, the first payload whose format supports sampling with linear filtering on the device is used
+*
+* @param viewType VK_IMAGE_VIEW_TYPE_2D for single layer textures or VK_IMAGE_VIEW_TYPE_2D_ARRAY
+* @param frames Receives the sprite frames stored in the file
+* @param batch (Optional) Batch that records the upload, the payload is staged before the file is unmapped
+* @return Format of the uploaded payload, VK_FORMAT_UNDEFINED if the file is missing, invalid or has no usable payload
+*/
+inline VkFormat load(const std::string& filename, vks::Texture& texture, VkImageViewType viewType, std::vector<TextureAtlas::Frame>& frames,
+    vks::VulkanDevice* device, VkQueue copyQueue, vks::TextureUploadBatch* batch = nullptr)
+{
+    MappedFile file;
+    Selection selection;
+    if (!file.open(filename) || !select(file, viewType, device, selection)) {
+        return VK_FORMAT_UNDEFINED;
+    }
+    const Header& header = selection.header;
+    texture.fromRegions(selection.data, selection.size, selection.format, header.width, header.height, header.layerCount, header.mipLevels,
+        selection.regions, viewType, device, copyQueue, batch);
+    frames.swap(selection.frames);
+    return selection.format;
+}
+}
+}
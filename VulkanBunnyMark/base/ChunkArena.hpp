@@ -0,0 +1,104 @@
+/*
+* Fixed-size chunk arena
+*
+* Hands out equally sized, cache line aligned memory chunks that never move once allocated.
+* Chunks of 2 MiB are aligned to the huge page size and advised as huge pages on Linux,
+* so large working sets (a million bunnies) are backed by few TLB entries.
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <assert.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <new>
+#include <vector>
+
+#if defined(_WIN32)
+#include <malloc.h>
+#elif defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+namespace vks {
+
+class ChunkArena {
+public:
+    static const size_t minChunkSize = 64 * 1024;
+    static const size_t maxChunkSize = 2 * 1024 * 1024;
+    static const size_t hugePageSize = 2 * 1024 * 1024;
+    static const size_t cacheLineSize = 64;
+
+    ChunkArena(size_t chunkSize = maxChunkSize) { setChunkSize(chunkSize); }
+    ~ChunkArena() { clear(); }
+
+    ChunkArena(const ChunkArena&) = delete;
+    ChunkArena& operator=(const ChunkArena&) = delete;
+
+    /** @brief Clamps the requested size to [minChunkSize, maxChunkSize], rounded to a power of two. Only valid while the arena is empty */
+    void setChunkSize(size_t size)
+    {
+        assert(chunks.empty());
+        size_t s = minChunkSize;
+        while (s < size && s < maxChunkSize) {
+            s <<= 1;
+        }
+        chunkSize = s;
+    }
+
+    size_t getChunkSize() const { return chunkSize; }
+    size_t getChunkCount() const { return chunks.size(); }
+    size_t getReservedBytes() const { return chunks.size() * chunkSize; }
+
+    /** @brief Returns a new chunk of getChunkSize() bytes, aligned to at least a cache line */
+    void* allocate()
+    {
+        size_t alignment = (chunkSize >= hugePageSize) ? hugePageSize : cacheLineSize;
+        void* ptr = nullptr;
+#if defined(_WIN32)
+        ptr = _aligned_malloc(chunkSize, alignment);
+#else
+        if (posix_memalign(&ptr, alignment, chunkSize) != 0) {
+            ptr = nullptr;
+        }
+#endif
+        if (!ptr) {
+            throw std::bad_alloc();
+        }
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+        if (chunkSize >= hugePageSize) {
+            // Advisory only, transparent huge pages may be disabled system wide
+            madvise(ptr, chunkSize, MADV_HUGEPAGE);
+        }
+#endif
+        chunks.push_back(ptr);
+        return ptr;
+    }
+
+    /** @brief Frees every chunk handed out by this arena */
+    void clear()
+    {
+        for (void* ptr : chunks) {
+#if defined(_WIN32)
+            _aligned_free(ptr);
+#else
+            free(ptr);
+#endif
+        }
+        chunks.clear();
+    }
+
+    /** @brief Rounds an offset up to the next cache line */
+    static size_t alignUp(size_t offset, size_t alignment = cacheLineSize)
+    {
+        return (offset + alignment - 1) & ~(alignment - 1);
+    }
+
+private:
+    size_t chunkSize;
+    std::vector<void*> chunks;
+};
+}
@@ -0,0 +1,151 @@
+/*
+* Frame pacing: target frame rate limiter and low-latency input sampling
+*
+* The render loop calls beginFrame() before it samples input. With a target frame rate that call waits for the next
+* frame slot, sleeping while the deadline is far off and spinning for the last stretch the OS sleep can't hit reliably.
+* In low-latency mode it instead sleeps away the time the previous frames spent blocked on the swap chain (acquire,
+* fence and present waits, reported through beginWait()/endWait()), so input and simulation run just before the frame
+* is needed instead of a full swap chain depth ahead of the display.
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+namespace vks {
+
+class FramePacer {
+public:
+    typedef std::chrono::high_resolution_clock Clock;
+
+    /** @brief Frame rate the limiter holds, 0 disables it */
+    float targetFps = 0.0f;
+    /** @brief Delays input sampling until just before the swap chain is expected to release the next image */
+    bool lowLatency = false;
+    /** @brief Spin for the last part of a wait for tighter pacing, disable to favour CPU time over precision */
+    bool spin = true;
+
+    /** @brief Waits as requested by the limiter or the low-latency mode, call right before input is sampled */
+    void beginFrame()
+    {
+        const Clock::time_point frameStart = Clock::now();
+
+        // Whatever the last frame blocked on is slack that low-latency mode can move in front of input sampling
+        if (frameCount > 0) {
+            const double slack = lastSleep + blocked;
+            // Shrink right away so the next frame doesn't miss its slot, grow slowly to ride out a single long wait
+            predictedSlack = (slack < predictedSlack) ? slack : predictedSlack + (slack - predictedSlack) * 0.1;
+        }
+        blocked = 0.0;
+
+        Clock::time_point deadline = frameStart;
+        if (targetFps > 0.0f) {
+            const Clock::duration period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / targetFps));
+            nextSlot += period;
+            // Start over instead of rushing through frames to catch up after a hitch
+            if ((frameCount == 0) || (nextSlot + period < frameStart)) {
+                nextSlot = frameStart;
+            }
+            deadline = nextSlot;
+        }
+        if (lowLatency) {
+            // Keep a safety margin for wakeup jitter and frame time variance
+            const double delay = predictedSlack - std::max(0.001, predictedSlack * 0.1);
+            if (delay > 0.0) {
+                deadline = std::max(deadline, frameStart + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(delay)));
+            }
+        }
+
+        waitUntil(deadline);
+        inputTime = Clock::now();
+        lastSleep = std::chrono::duration<double>(inputTime - frameStart).count();
+        frameCount++;
+    }
+
+    /** @brief Brackets a call that blocks on the swap chain or the GPU */
+    void beginWait()
+    {
+        waitStart = Clock::now();
+    }
+
+    void endWait()
+    {
+        blocked += std::chrono::duration<double>(Clock::now() - waitStart).count();
+    }
+
+    /** @brief The simulation state now reflects the input sampled by the last beginFrame() */
+    void simulated()
+    {
+        simulatedInput = inputTime;
+        hasSimulatedInput = true;
+    }
+
+    /** @brief A frame containing the last simulated state has been submitted */
+    void submitted()
+    {
+        if (!hasSimulatedInput) {
+            return;
+        }
+        addLatency(std::chrono::duration<double, std::milli>(Clock::now() - simulatedInput).count());
+        hasSimulatedInput = false;
+    }
+
+    /** @brief Input sample time the last simulated() refers to, for frames submitted by another thread */
+    Clock::time_point simulatedInputTime() const { return simulatedInput; }
+
+    /** @brief Adds an input to submit latency in milliseconds measured outside of submitted() */
+    void addLatency(double latency)
+    {
+        latencyMs = (latencyMs == 0.0) ? latency : latencyMs + (latency - latencyMs) * 0.05;
+    }
+
+    /** @brief Smoothed time in milliseconds from sampling input to submitting the frame that shows its effect */
+    double inputLatency() const { return latencyMs; }
+
+    /** @brief Seconds the last beginFrame() waited */
+    double waited() const { return lastSleep; }
+
+private:
+    Clock::time_point nextSlot;
+    Clock::time_point inputTime;
+    Clock::time_point simulatedInput;
+    Clock::time_point waitStart;
+    bool hasSimulatedInput = false;
+    uint64_t frameCount = 0;
+    double blocked = 0.0;
+    double lastSleep = 0.0;
+    double predictedSlack = 0.0;
+    double latencyMs = 0.0;
+    // How late the OS wakes up from a sleep, adapted from observed wakeups
+    double oversleep = 0.001;
+
+    void waitUntil(Clock::time_point deadline)
+    {
+        for (;;) {
+            const Clock::time_point now = Clock::now();
+            if (now >= deadline) {
+                return;
+            }
+            const double remaining = std::chrono::duration<double>(deadline - now).count();
+            const double margin = spin ? std::min(std::max(oversleep * 1.5, 0.0002), 0.004) : 0.0;
+            if (remaining > margin) {
+                const double request = remaining - margin;
+                std::this_thread::sleep_for(std::chrono::duration<double>(request));
+                const double slept = std::chrono::duration<double>(Clock::now() - now).count();
+                oversleep += (std::max(slept - request, 0.0) - oversleep) * 0.1;
+                if (!spin) {
+                    return;
+                }
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    }
+};
+
+}
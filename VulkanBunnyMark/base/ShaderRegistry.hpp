@@ -0,0 +1,61 @@
+/*
+* Registry of SPIR-V shaders embedded at build time
+*
+* Builds that define VKS_EMBEDDED_SHADERS run data/shaders/embedshaders.py, which compiles every shader of
+* data/shaders and writes the code to EmbeddedShaders.h. Shaders are resolved by their path below data/shaders,
+* e.g. "bunnymark/sprite.vert.spv". Without embedded shaders every lookup fails and shaders are read from files.
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+namespace vks {
+namespace shaders {
+
+struct Shader {
+    const char* name;
+    const uint32_t* code;
+    // In bytes
+    size_t size;
+};
+
+}
+}
+
+#if defined(VKS_EMBEDDED_SHADERS)
+#include "EmbeddedShaders.h"
+#endif
+
+namespace vks {
+namespace shaders {
+
+/** @brief Number of embedded shaders, 0 if the build doesn't embed them */
+inline size_t count()
+{
+#if defined(VKS_EMBEDDED_SHADERS)
+    return sizeof(embedded) / sizeof(embedded[0]);
+#else
+    return 0;
+#endif
+}
+
+/** @brief Embedded shader of the given name, nullptr if there is none */
+inline const Shader* find(const std::string& name)
+{
+#if defined(VKS_EMBEDDED_SHADERS)
+    for (const Shader& shader : embedded) {
+        if (name == shader.name) {
+            return &shader;
+        }
+    }
+#endif
+    return nullptr;
+}
+
+}
+}
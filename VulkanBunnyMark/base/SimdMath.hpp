@@ -0,0 +1,376 @@
+/*
+* Batched SIMD math helpers
+*
+* sincos is the Cephes single precision polynomial (as used by sse_mathfun/neon_mathfun),
+* evaluated 8 (AVX2), 4 (SSE2, NEON) or 1 lane at a time, the scalar tail uses the same polynomial.
+*
+* Error bound, measured against libm sin/cos in double precision over 2^24 uniform samples:
+*   |x| <= 8192 : absolute error < 8e-8 for both sin and cos (libm sinf/cosf: < 3.3e-8),
+*   |x| >  8192 : the three part pi/4 reduction loses accuracy, keep angles wrapped to a few turns.
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#define VKS_SIMD_AVX2 1
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VKS_SIMD_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define VKS_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace vks {
+namespace simd {
+
+namespace detail {
+    const float FOPI = 1.27323954473516f; // 4 / pi
+    const float DP1 = -0.78515625f;
+    const float DP2 = -2.4187564849853515625e-4f;
+    const float DP3 = -3.77489497744594108e-8f;
+    const float sincofP0 = -1.9515295891e-4f;
+    const float sincofP1 = 8.3321608736e-3f;
+    const float sincofP2 = -1.6666654611e-1f;
+    const float coscofP0 = 2.443315711809948e-5f;
+    const float coscofP1 = -1.388731625493765e-3f;
+    const float coscofP2 = 4.166664568298827e-2f;
+
+    // Each Ops type wraps one register width: F holds floats, I holds 32 bit integers of the same lane count.
+    // Comparisons return all-bits-set lanes for true, select(mask, a, b) picks a where the mask is set.
+    struct ScalarOps {
+        typedef float F;
+        typedef int32_t I;
+        static const int width = 1;
+        static F load(const float* p) { return *p; }
+        static void store(float* p, F v) { *p = v; }
+        static F set(float v) { return v; }
+        static I seti(int32_t v) { return v; }
+        static F add(F a, F b) { return a + b; }
+        static F sub(F a, F b) { return a - b; }
+        static F mul(F a, F b) { return a * b; }
+        static I asInt(F v) { I i; memcpy(&i, &v, sizeof(i)); return i; }
+        static F asFloat(I i) { F v; memcpy(&v, &i, sizeof(v)); return v; }
+        static F bitAnd(F a, F b) { return asFloat(asInt(a) & asInt(b)); }
+        static F bitAndNot(F a, F b) { return asFloat(~asInt(a) & asInt(b)); }
+        static F bitOr(F a, F b) { return asFloat(asInt(a) | asInt(b)); }
+        static F bitXor(F a, F b) { return asFloat(asInt(a) ^ asInt(b)); }
+        static I toInt(F v) { return (I)v; }
+        static F toFloat(I i) { return (F)i; }
+        static I addi(I a, I b) { return a + b; }
+        static I andi(I a, I b) { return a & b; }
+        static I andnoti(I a, I b) { return ~a & b; }
+        static I eqi(I a, I b) { return a == b ? -1 : 0; }
+        static I shl29(I a) { return (I)((uint32_t)a << 29); }
+        static F min(F a, F b) { return b < a ? b : a; }
+        static F max(F a, F b) { return a < b ? b : a; }
+        static F cmpgt(F a, F b) { return asFloat(a > b ? -1 : 0); }
+        static F cmplt(F a, F b) { return asFloat(a < b ? -1 : 0); }
+        static F select(F mask, F a, F b) { return bitOr(bitAnd(mask, a), bitAndNot(mask, b)); }
+        static I iota() { return 0; }
+        static I xori(I a, I b) { return a ^ b; }
+        static I mulu(I a, I b) { return (I)((uint32_t)a * (uint32_t)b); }
+        template <int N> static I srli(I a) { return (I)((uint32_t)a >> N); }
+    };
+
+#if defined(VKS_SIMD_AVX2)
+    struct AvxOps {
+        typedef __m256 F;
+        typedef __m256i I;
+        static const int width = 8;
+        static F load(const float* p) { return _mm256_loadu_ps(p); }
+        static void store(float* p, F v) { _mm256_storeu_ps(p, v); }
+        static F set(float v) { return _mm256_set1_ps(v); }
+        static I seti(int32_t v) { return _mm256_set1_epi32(v); }
+        static F add(F a, F b) { return _mm256_add_ps(a, b); }
+        static F sub(F a, F b) { return _mm256_sub_ps(a, b); }
+        static F mul(F a, F b) { return _mm256_mul_ps(a, b); }
+        static I asInt(F v) { return _mm256_castps_si256(v); }
+        static F asFloat(I i) { return _mm256_castsi256_ps(i); }
+        static F bitAnd(F a, F b) { return _mm256_and_ps(a, b); }
+        static F bitAndNot(F a, F b) { return _mm256_andnot_ps(a, b); }
+        static F bitOr(F a, F b) { return _mm256_or_ps(a, b); }
+        static F bitXor(F a, F b) { return _mm256_xor_ps(a, b); }
+        static I toInt(F v) { return _mm256_cvttps_epi32(v); }
+        static F toFloat(I i) { return _mm256_cvtepi32_ps(i); }
+        static I addi(I a, I b) { return _mm256_add_epi32(a, b); }
+        static I andi(I a, I b) { return _mm256_and_si256(a, b); }
+        static I andnoti(I a, I b) { return _mm256_andnot_si256(a, b); }
+        static I eqi(I a, I b) { return _mm256_cmpeq_epi32(a, b); }
+        static I shl29(I a) { return _mm256_slli_epi32(a, 29); }
+        static F min(F a, F b) { return _mm256_min_ps(a, b); }
+        static F max(F a, F b) { return _mm256_max_ps(a, b); }
+        static F cmpgt(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+        static F cmplt(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+        static F select(F mask, F a, F b) { return _mm256_blendv_ps(b, a, mask); }
+        static I iota() { return _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7); }
+        static I xori(I a, I b) { return _mm256_xor_si256(a, b); }
+        static I mulu(I a, I b) { return _mm256_mullo_epi32(a, b); }
+        template <int N> static I srli(I a) { return _mm256_srli_epi32(a, N); }
+    };
+#endif
+
+#if defined(VKS_SIMD_AVX2) || defined(VKS_SIMD_SSE2)
+    struct SseOps {
+        typedef __m128 F;
+        typedef __m128i I;
+        static const int width = 4;
+        static F load(const float* p) { return _mm_loadu_ps(p); }
+        static void store(float* p, F v) { _mm_storeu_ps(p, v); }
+        static F set(float v) { return _mm_set1_ps(v); }
+        static I seti(int32_t v) { return _mm_set1_epi32(v); }
+        static F add(F a, F b) { return _mm_add_ps(a, b); }
+        static F sub(F a, F b) { return _mm_sub_ps(a, b); }
+        static F mul(F a, F b) { return _mm_mul_ps(a, b); }
+        static I asInt(F v) { return _mm_castps_si128(v); }
+        static F asFloat(I i) { return _mm_castsi128_ps(i); }
+        static F bitAnd(F a, F b) { return _mm_and_ps(a, b); }
+        static F bitAndNot(F a, F b) { return _mm_andnot_ps(a, b); }
+        static F bitOr(F a, F b) { return _mm_or_ps(a, b); }
+        static F bitXor(F a, F b) { return _mm_xor_ps(a, b); }
+        static I toInt(F v) { return _mm_cvttps_epi32(v); }
+        static F toFloat(I i) { return _mm_cvtepi32_ps(i); }
+        static I addi(I a, I b) { return _mm_add_epi32(a, b); }
+        static I andi(I a, I b) { return _mm_and_si128(a, b); }
+        static I andnoti(I a, I b) { return _mm_andnot_si128(a, b); }
+        static I eqi(I a, I b) { return _mm_cmpeq_epi32(a, b); }
+        static I shl29(I a) { return _mm_slli_epi32(a, 29); }
+        static F min(F a, F b) { return _mm_min_ps(a, b); }
+        static F max(F a, F b) { return _mm_max_ps(a, b); }
+        static F cmpgt(F a, F b) { return _mm_cmpgt_ps(a, b); }
+        static F cmplt(F a, F b) { return _mm_cmplt_ps(a, b); }
+        static F select(F mask, F a, F b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+        static I iota() { return _mm_setr_epi32(0, 1, 2, 3); }
+        static I xori(I a, I b) { return _mm_xor_si128(a, b); }
+        // SSE2 has no 32 bit mullo, multiply even and odd lanes separately
+        static I mulu(I a, I b) {
+            __m128i even = _mm_mul_epu32(a, b);
+            __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+            return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+        }
+        template <int N> static I srli(I a) { return _mm_srli_epi32(a, N); }
+    };
+#endif
+
+#if defined(VKS_SIMD_NEON)
+    struct NeonOps {
+        typedef float32x4_t F;
+        typedef int32x4_t I;
+        static const int width = 4;
+        static F load(const float* p) { return vld1q_f32(p); }
+        static void store(float* p, F v) { vst1q_f32(p, v); }
+        static F set(float v) { return vdupq_n_f32(v); }
+        static I seti(int32_t v) { return vdupq_n_s32(v); }
+        static F add(F a, F b) { return vaddq_f32(a, b); }
+        static F sub(F a, F b) { return vsubq_f32(a, b); }
+        static F mul(F a, F b) { return vmulq_f32(a, b); }
+        static I asInt(F v) { return vreinterpretq_s32_f32(v); }
+        static F asFloat(I i) { return vreinterpretq_f32_s32(i); }
+        static F bitAnd(F a, F b) { return asFloat(vandq_s32(asInt(a), asInt(b))); }
+        static F bitAndNot(F a, F b) { return asFloat(vbicq_s32(asInt(b), asInt(a))); }
+        static F bitOr(F a, F b) { return asFloat(vorrq_s32(asInt(a), asInt(b))); }
+        static F bitXor(F a, F b) { return asFloat(veorq_s32(asInt(a), asInt(b))); }
+        static I toInt(F v) { return vcvtq_s32_f32(v); }
+        static F toFloat(I i) { return vcvtq_f32_s32(i); }
+        static I addi(I a, I b) { return vaddq_s32(a, b); }
+        static I andi(I a, I b) { return vandq_s32(a, b); }
+        static I andnoti(I a, I b) { return vbicq_s32(b, a); }
+        static I eqi(I a, I b) { return vreinterpretq_s32_u32(vceqq_s32(a, b)); }
+        static I shl29(I a) { return vshlq_n_s32(a, 29); }
+        static F min(F a, F b) { return vminq_f32(a, b); }
+        static F max(F a, F b) { return vmaxq_f32(a, b); }
+        static F cmpgt(F a, F b) { return vreinterpretq_f32_u32(vcgtq_f32(a, b)); }
+        static F cmplt(F a, F b) { return vreinterpretq_f32_u32(vcltq_f32(a, b)); }
+        static F select(F mask, F a, F b) { return vbslq_f32(vreinterpretq_u32_f32(mask), a, b); }
+        static I iota() { static const int32_t lanes[4] = { 0, 1, 2, 3 }; return vld1q_s32(lanes); }
+        static I xori(I a, I b) { return veorq_s32(a, b); }
+        static I mulu(I a, I b) { return vmulq_s32(a, b); }
+        template <int N> static I srli(I a) { return vreinterpretq_s32_u32(vshrq_n_u32(vreinterpretq_u32_s32(a), N)); }
+    };
+#endif
+
+    template <typename Ops>
+    inline void sincos(typename Ops::F x, typename Ops::F& s, typename Ops::F& c)
+    {
+        typedef typename Ops::F F;
+        typedef typename Ops::I I;
+
+        const F signMask = Ops::asFloat(Ops::seti((int32_t)0x80000000));
+        F signSin = Ops::bitAnd(x, signMask);
+        x = Ops::bitAndNot(signMask, x);
+
+        // Octant of |x|, rounded up to even so the remainder lies in [-pi/4, pi/4]
+        I j = Ops::toInt(Ops::mul(x, Ops::set(FOPI)));
+        j = Ops::addi(j, Ops::seti(1));
+        j = Ops::andi(j, Ops::seti(~1));
+        F y = Ops::toFloat(j);
+
+        F swapSin = Ops::asFloat(Ops::shl29(Ops::andi(j, Ops::seti(4))));
+        F signCos = Ops::asFloat(Ops::shl29(Ops::andnoti(Ops::addi(j, Ops::seti(-2)), Ops::seti(4))));
+        F polyMask = Ops::asFloat(Ops::eqi(Ops::andi(j, Ops::seti(2)), Ops::seti(0)));
+        signSin = Ops::bitXor(signSin, swapSin);
+
+        // Extended precision modular arithmetic (Cody-Waite)
+        x = Ops::add(x, Ops::mul(y, Ops::set(DP1)));
+        x = Ops::add(x, Ops::mul(y, Ops::set(DP2)));
+        x = Ops::add(x, Ops::mul(y, Ops::set(DP3)));
+        F z = Ops::mul(x, x);
+
+        F yc = Ops::set(coscofP0);
+        yc = Ops::add(Ops::mul(yc, z), Ops::set(coscofP1));
+        yc = Ops::add(Ops::mul(yc, z), Ops::set(coscofP2));
+        yc = Ops::mul(Ops::mul(yc, z), z);
+        yc = Ops::sub(yc, Ops::mul(z, Ops::set(0.5f)));
+        yc = Ops::add(yc, Ops::set(1.0f));
+
+        F ys = Ops::set(sincofP0);
+        ys = Ops::add(Ops::mul(ys, z), Ops::set(sincofP1));
+        ys = Ops::add(Ops::mul(ys, z), Ops::set(sincofP2));
+        ys = Ops::mul(Ops::mul(ys, z), x);
+        ys = Ops::add(ys, x);
+
+        s = Ops::bitOr(Ops::bitAnd(polyMask, ys), Ops::bitAndNot(polyMask, yc));
+        c = Ops::bitOr(Ops::bitAnd(polyMask, yc), Ops::bitAndNot(polyMask, ys));
+        s = Ops::bitXor(s, signSin);
+        c = Ops::bitXor(c, signCos);
+    }
+
+    template <typename Ops>
+    inline uint32_t sincosBlock(const float* angles, float* sinOut, float* cosOut, uint32_t count)
+    {
+        uint32_t i = 0;
+        for (; i + Ops::width <= count; i += Ops::width) {
+            typename Ops::F s, c;
+            sincos<Ops>(Ops::load(angles + i), s, c);
+            Ops::store(sinOut + i, s);
+            Ops::store(cosOut + i, c);
+        }
+        return i;
+    }
+
+    // Writes the column major 2x2 matrix scale * rotation (glm::mat2 layout) of lanes [i, i + width)
+    template <typename Ops>
+    inline void storeScaleRotation(typename Ops::F scale, typename Ops::F s, typename Ops::F c, float* out, size_t stride)
+    {
+        const int width = Ops::width;
+        float m[4][width];
+        Ops::store(m[0], Ops::mul(scale, c));
+        Ops::store(m[1], Ops::sub(Ops::set(0.f), Ops::mul(scale, s)));
+        Ops::store(m[2], Ops::mul(scale, s));
+        Ops::store(m[3], Ops::mul(scale, c));
+        for (int k = 0; k < width; k++) {
+            float* dst = out + k * stride;
+            dst[0] = m[0][k];
+            dst[1] = m[1][k];
+            dst[2] = m[2][k];
+            dst[3] = m[3][k];
+        }
+    }
+
+#if defined(VKS_SIMD_AVX2) || defined(VKS_SIMD_SSE2)
+    template <>
+    inline void storeScaleRotation<SseOps>(__m128 scale, __m128 s, __m128 c, float* out, size_t stride)
+    {
+        __m128 m0 = _mm_mul_ps(scale, c);
+        __m128 m2 = _mm_mul_ps(scale, s);
+        __m128 m1 = _mm_sub_ps(_mm_setzero_ps(), m2);
+        __m128 m3 = m0;
+        _MM_TRANSPOSE4_PS(m0, m1, m2, m3);
+        _mm_storeu_ps(out, m0);
+        _mm_storeu_ps(out + stride, m1);
+        _mm_storeu_ps(out + 2 * stride, m2);
+        _mm_storeu_ps(out + 3 * stride, m3);
+    }
+#endif
+
+#if defined(VKS_SIMD_AVX2)
+    template <>
+    inline void storeScaleRotation<AvxOps>(__m256 scale, __m256 s, __m256 c, float* out, size_t stride)
+    {
+        storeScaleRotation<SseOps>(_mm256_castps256_ps128(scale), _mm256_castps256_ps128(s), _mm256_castps256_ps128(c), out, stride);
+        storeScaleRotation<SseOps>(_mm256_extractf128_ps(scale, 1), _mm256_extractf128_ps(s, 1), _mm256_extractf128_ps(c, 1), out + 4 * stride, stride);
+    }
+#endif
+
+    template <typename Ops>
+    inline uint32_t scaleRotationBlock(const float* scale, const float* rotation, float* out, size_t stride, uint32_t count)
+    {
+        uint32_t i = 0;
+        for (; i + Ops::width <= count; i += Ops::width) {
+            typename Ops::F s, c;
+            sincos<Ops>(Ops::load(rotation + i), s, c);
+            storeScaleRotation<Ops>(Ops::load(scale + i), s, c, out + i * stride, stride);
+        }
+        return i;
+    }
+
+#if defined(VKS_SIMD_AVX2)
+    typedef AvxOps WideOps;
+#elif defined(VKS_SIMD_SSE2)
+    typedef SseOps WideOps;
+#elif defined(VKS_SIMD_NEON)
+    typedef NeonOps WideOps;
+#else
+    typedef ScalarOps WideOps;
+#endif
+}
+
+/**
+* Register wrapper for kernels written against the Ops interface above, Lanes<Width>::Ops has Width float lanes
+* or falls back to the widest set available below Width on this build (down to plain scalar code)
+*/
+template <uint32_t Width>
+struct Lanes {
+    typedef detail::ScalarOps Ops;
+};
+template <>
+struct Lanes<4> {
+#if defined(VKS_SIMD_AVX2) || defined(VKS_SIMD_SSE2)
+    typedef detail::SseOps Ops;
+#elif defined(VKS_SIMD_NEON)
+    typedef detail::NeonOps Ops;
+#else
+    typedef detail::ScalarOps Ops;
+#endif
+};
+template <>
+struct Lanes<8> {
+#if defined(VKS_SIMD_AVX2)
+    typedef detail::AvxOps Ops;
+#else
+    typedef Lanes<4>::Ops Ops;
+#endif
+};
+
+/** @brief Number of lanes processed per iteration by the batched functions on this build */
+inline int lanes() { return detail::WideOps::width; }
+
+/** @brief sinOut[i] = sin(angles[i]), cosOut[i] = cos(angles[i]) */
+inline void sincos(const float* angles, float* sinOut, float* cosOut, uint32_t count)
+{
+    uint32_t i = detail::sincosBlock<detail::WideOps>(angles, sinOut, cosOut, count);
+    detail::sincosBlock<detail::ScalarOps>(angles + i, sinOut + i, cosOut + i, count - i);
+}
+
+/**
+* Builds scale * rotation matrices for whole arrays
+*
+* @param scale Uniform scale per element
+* @param rotation Rotation in radians per element
+* @param out First matrix, written as 4 floats in glm::mat2 (column major) order
+* @param stride Distance between consecutive matrices in floats, e.g. sizeof(InstanceData) / sizeof(float)
+* @param count Number of elements
+*/
+inline void buildScaleRotation(const float* scale, const float* rotation, float* out, size_t stride, uint32_t count)
+{
+    uint32_t i = detail::scaleRotationBlock<detail::WideOps>(scale, rotation, out, stride, count);
+    detail::scaleRotationBlock<detail::ScalarOps>(scale + i, rotation + i, out + i * stride, stride, count - i);
+}
+}
+}
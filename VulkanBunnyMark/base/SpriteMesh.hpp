@@ -0,0 +1,185 @@
+/*
+* Alpha-trimmed sprite meshes
+*
+* A sprite drawn as a full rectangle still runs the fragment shader for every transparent texel around its shape.
+* SpriteMesh builds a convex polygon that encloses the covered texels of a sprite instead. The covered area is dilated
+* so that neither bilinear filtering nor the first mip levels can pull visible texels from outside the polygon. The
+* convex hull is then cut down to a vertex budget by merging the edges that add the least area. The polygon never leaves
+* the sprite rectangle, so it only ever samples texels of its own frame. It is drawn as a triangle fan.
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
+namespace vks {
+
+class SpriteMesh {
+public:
+    struct Point {
+        float x;
+        float y;
+    };
+
+    /** @brief Convex polygon in texels of the sprite, (0, 0) is the top left corner of its rectangle */
+    std::vector<Point> vertices;
+
+    /** @brief Marks the texels of a width x height RGBA8 sprite with alpha above the threshold, pitch is the row length of the image in texels */
+    static void addCoverage(std::vector<uint8_t>& coverage, const uint8_t* rgba, uint32_t pitch, uint32_t width, uint32_t height, uint8_t alphaThreshold = 0)
+    {
+        coverage.resize((size_t)width * height, 0);
+        for (uint32_t y = 0; y < height; y++) {
+            const uint8_t* row = rgba + (size_t)y * pitch * 4;
+            for (uint32_t x = 0; x < width; x++) {
+                if (row[x * 4 + 3] > alphaThreshold) {
+                    coverage[(size_t)y * width + x] = 1;
+                }
+            }
+        }
+    }
+
+    /**
+    * Builds the polygon around the covered texels, grown by padding texels
+    *
+    * Falls back to the full rectangle if nothing is covered or the hull can't be reduced to maxVertices (at least 3).
+    */
+    void build(const std::vector<uint8_t>& coverage, uint32_t width, uint32_t height, uint32_t maxVertices, uint32_t padding = 1)
+    {
+        // Only the outermost covered texels of a row can be hull vertices
+        std::vector<Point> points;
+        for (uint32_t y = 0; y < height; y++) {
+            const uint8_t* row = coverage.data() + (size_t)y * width;
+            uint32_t first = width, last = 0;
+            for (uint32_t x = 0; x < width; x++) {
+                if (row[x]) {
+                    first = std::min(first, x);
+                    last = x;
+                }
+            }
+            if (first == width) {
+                continue;
+            }
+            const float x0 = (float)(first > padding ? first - padding : 0);
+            const float x1 = (float)std::min(last + 1 + padding, width);
+            const float y0 = (float)(y > padding ? y - padding : 0);
+            const float y1 = (float)std::min(y + 1 + padding, height);
+            const Point corners[4] = { { x0, y0 }, { x1, y0 }, { x0, y1 }, { x1, y1 } };
+            points.insert(points.end(), corners, corners + 4);
+        }
+        if (points.empty()) {
+            rectangle(width, height);
+            return;
+        }
+        vertices = convexHull(points);
+        while (vertices.size() > maxVertices && removeEdge((float)width, (float)height)) {
+        }
+        if (vertices.size() > maxVertices) {
+            rectangle(width, height);
+        }
+    }
+
+    /** @brief The full sprite rectangle */
+    void rectangle(uint32_t width, uint32_t height)
+    {
+        const float w = (float)width, h = (float)height;
+        vertices.clear();
+        const Point corners[4] = { { w, h }, { 0.f, h }, { 0.f, 0.f }, { w, 0.f } };
+        vertices.insert(vertices.end(), corners, corners + 4);
+    }
+
+    /** @brief Area of the polygon in texels */
+    float area() const
+    {
+        float sum = 0.f;
+        for (size_t i = 0; i < vertices.size(); i++) {
+            const Point& a = vertices[i];
+            const Point& b = vertices[(i + 1) % vertices.size()];
+            sum += a.x * b.y - b.x * a.y;
+        }
+        return fabsf(sum) * 0.5f;
+    }
+
+private:
+    static float cross(const Point& o, const Point& a, const Point& b)
+    {
+        return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x);
+    }
+
+    // Monotone chain, collinear points are dropped
+    static std::vector<Point> convexHull(std::vector<Point> points)
+    {
+        std::sort(points.begin(), points.end(), [](const Point& a, const Point& b) {
+            return (a.x < b.x) || (a.x == b.x && a.y < b.y);
+        });
+        std::vector<Point> hull(points.size() * 2);
+        size_t k = 0;
+        for (size_t i = 0; i < points.size(); i++) {
+            while (k >= 2 && cross(hull[k - 2], hull[k - 1], points[i]) <= 0.f) {
+                k--;
+            }
+            hull[k++] = points[i];
+        }
+        for (size_t i = points.size() - 1, lower = k + 1; i-- > 0;) {
+            while (k >= lower && cross(hull[k - 2], hull[k - 1], points[i]) <= 0.f) {
+                k--;
+            }
+            hull[k++] = points[i];
+        }
+        hull.resize(k > 1 ? k - 1 : k);
+        return hull;
+    }
+
+    // Replaces the edge b-c by extending its neighbours a-b and d-c until they meet, choosing the edge that adds the least
+    // area while the meeting point stays inside the rectangle. Returns false if no edge can go.
+    bool removeEdge(float width, float height)
+    {
+        const size_t n = vertices.size();
+        const float epsilon = 1e-3f;
+        size_t best = n;
+        float bestArea = 0.f;
+        Point bestPoint = { 0.f, 0.f };
+        for (size_t i = 0; i < n; i++) {
+            const Point& a = vertices[(i + n - 1) % n];
+            const Point& b = vertices[i];
+            const Point& c = vertices[(i + 1) % n];
+            const Point& d = vertices[(i + 2) % n];
+            // p = b + t * (b - a) = c + s * (c - d), both extensions have to run forward
+            const Point u = { b.x - a.x, b.y - a.y };
+            const Point v = { c.x - d.x, c.y - d.y };
+            const float denominator = u.x * v.y - u.y * v.x;
+            if (fabsf(denominator) < epsilon) {
+                continue;
+            }
+            const Point bc = { c.x - b.x, c.y - b.y };
+            const float t = (bc.x * v.y - bc.y * v.x) / denominator;
+            const float s = (bc.x * u.y - bc.y * u.x) / denominator;
+            if (t < 0.f || s < 0.f) {
+                continue;
+            }
+            const Point p = { b.x + t * u.x, b.y + t * u.y };
+            if (p.x < -epsilon || p.y < -epsilon || p.x > width + epsilon || p.y > height + epsilon) {
+                continue;
+            }
+            const float added = fabsf(cross(b, p, c)) * 0.5f;
+            if (best == n || added < bestArea) {
+                best = i;
+                bestArea = added;
+                bestPoint.x = std::min(std::max(p.x, 0.f), width);
+                bestPoint.y = std::min(std::max(p.y, 0.f), height);
+            }
+        }
+        if (best == n) {
+            return false;
+        }
+        vertices[best] = bestPoint;
+        vertices.erase(vertices.begin() + (best + 1) % n);
+        return true;
+    }
+};
+
+}
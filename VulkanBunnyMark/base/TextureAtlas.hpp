@@ -0,0 +1,201 @@
+/*
+* Runtime texture atlas
+*
+* Packs RGBA8 images into square pages with the stb rect packer bundled with imgui and builds
+* the mip chain of every page. Each image is surrounded by a border of replicated edge texels and
+* placed on a multiple of the texel size of the smallest mip, so neither the box filter nor
+* bilinear sampling of any level mixes neighbouring images.
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "imgui/imstb_rectpack.h"
+#include "VulkanBuffer.hpp"
+#include "VulkanTexture.hpp"
+
+namespace vks {
+
+class TextureAtlas {
+public:
+    static const uint32_t minPageSize = 256;
+
+    // Texel rectangle of an image on mip level 0 of its page, without the border
+    struct Frame {
+        uint32_t page;
+        uint32_t x;
+        uint32_t y;
+        uint32_t width;
+        uint32_t height;
+    };
+
+    /** @brief maxPageSize must be a power of two, more mip levels need wider borders between the images */
+    TextureAtlas(uint32_t maxPageSize = 4096, uint32_t mipLevels = 4)
+        : maxPageSize(maxPageSize), mipLevels(std::max(mipLevels, 1u))
+    {
+    }
+
+    /** @brief Adds an RGBA8 image (the pixels are copied) and returns its frame index */
+    uint32_t add(const uint8_t* pixels, uint32_t width, uint32_t height)
+    {
+        Image image;
+        image.width = width;
+        image.height = height;
+        image.pixels.assign(pixels, pixels + (size_t)width * height * 4);
+        images.push_back(image);
+        return (uint32_t)images.size() - 1;
+    }
+
+    /**
+    * Packs all added images into pages and fills the page texels including the mip chains
+    *
+    * A single page is shrunk to the smallest power of two that holds every image, additional pages are maxPageSize squares.
+    * @return False if an image doesn't fit on a page of maxPageSize
+    */
+    bool build()
+    {
+        // Cells are aligned to the texel size of the coarsest level, the border covers its bilinear footprint
+        const uint32_t align = 1u << (mipLevels - 1);
+        const uint32_t border = align;
+        std::vector<stbrp_rect> rects(images.size());
+        for (size_t i = 0; i < images.size(); i++) {
+            memset(&rects[i], 0, sizeof(stbrp_rect));
+            rects[i].id = (int)i;
+            rects[i].w = (stbrp_coord)alignUp(images[i].width + 2 * border, align);
+            rects[i].h = (stbrp_coord)alignUp(images[i].height + 2 * border, align);
+        }
+
+        std::vector<Frame> cells;
+        bool packed = false;
+        for (pageSize = std::min((uint32_t)minPageSize, maxPageSize); ; pageSize *= 2) {
+            packed = pack(rects, cells);
+            if ((packed && pageCount == 1) || pageSize >= maxPageSize) {
+                break;
+            }
+        }
+        if (!packed) {
+            return false;
+        }
+        mipLevels = std::min(mipLevels, log2(pageSize) + 1);
+
+        pageBytes = 0;
+        for (uint32_t level = 0; level < mipLevels; level++) {
+            pageBytes += (size_t)(pageSize >> level) * (pageSize >> level) * 4;
+        }
+        pixels.assign(pageBytes * pageCount, 0);
+
+        frames.resize(images.size());
+        for (size_t i = 0; i < images.size(); i++) {
+            Frame& frame = frames[i];
+            frame.page = cells[i].page;
+            frame.x = cells[i].x + border;
+            frame.y = cells[i].y + border;
+            frame.width = images[i].width;
+            frame.height = images[i].height;
+            blit(images[i], frame, border);
+        }
+        for (uint32_t page = 0; page < pageCount; page++) {
+            uint8_t* level = pixels.data() + page * pageBytes;
+            std::vector<uint8_t> chain = Texture::buildMipChain(level, pageSize, pageSize, mipLevels);
+            assert(chain.size() == pageBytes);
+            memcpy(level, chain.data(), pageBytes);
+        }
+        images.clear();
+        return true;
+    }
+
+    uint32_t getPageSize() const { return pageSize; }
+    uint32_t getPageCount() const { return pageCount; }
+    uint32_t getMipLevels() const { return mipLevels; }
+    const std::vector<Frame>& getFrames() const { return frames; }
+    /** @brief Bytes of one page including all mip levels */
+    size_t getPageBytes() const { return pageBytes; }
+    /** @brief All pages back to back, each one followed by its mip levels (the layout Texture2DArray::fromBuffer expects) */
+    const std::vector<uint8_t>& getPixels() const { return pixels; }
+
+private:
+    struct Image {
+        std::vector<uint8_t> pixels;
+        uint32_t width;
+        uint32_t height;
+    };
+
+    uint32_t maxPageSize;
+    uint32_t mipLevels;
+    uint32_t pageSize = 0;
+    uint32_t pageCount = 0;
+    size_t pageBytes = 0;
+    std::vector<Image> images;
+    std::vector<Frame> frames;
+    std::vector<uint8_t> pixels;
+
+    static uint32_t alignUp(uint32_t value, uint32_t alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    static uint32_t log2(uint32_t value)
+    {
+        uint32_t result = 0;
+        while (value > 1) {
+            value >>= 1;
+            result++;
+        }
+        return result;
+    }
+
+    // Fills pages of pageSize until every rect is placed, cells receive page and position of each rect
+    bool pack(std::vector<stbrp_rect>& rects, std::vector<Frame>& cells)
+    {
+        for (auto& rect : rects) {
+            if ((uint32_t)rect.w > pageSize || (uint32_t)rect.h > pageSize) {
+                return false;
+            }
+            rect.was_packed = 0;
+        }
+        cells.resize(rects.size());
+        std::vector<stbrp_node> nodes(pageSize);
+        std::vector<stbrp_rect> remaining = rects;
+        for (pageCount = 0; !remaining.empty(); pageCount++) {
+            stbrp_context context;
+            stbrp_init_target(&context, (int)pageSize, (int)pageSize, nodes.data(), (int)nodes.size());
+            stbrp_pack_rects(&context, remaining.data(), (int)remaining.size());
+            std::vector<stbrp_rect> next;
+            for (auto& rect : remaining) {
+                if (rect.was_packed) {
+                    Frame& cell = cells[rect.id];
+                    cell.page = pageCount;
+                    cell.x = rect.x;
+                    cell.y = rect.y;
+                }
+                else {
+                    next.push_back(rect);
+                }
+            }
+            remaining.swap(next);
+        }
+        return true;
+    }
+
+    // Copies an image to level 0 of its page, the border repeats the edge texels
+    void blit(const Image& image, const Frame& frame, uint32_t border)
+    {
+        uint8_t* page = pixels.data() + frame.page * pageBytes;
+        for (uint32_t y = 0; y < image.height + 2 * border; y++) {
+            uint32_t srcY = std::min(std::max(y, border) - border, image.height - 1);
+            uint8_t* dst = page + ((size_t)(frame.y - border + y) * pageSize + frame.x - border) * 4;
+            for (uint32_t x = 0; x < image.width + 2 * border; x++) {
+                uint32_t srcX = std::min(std::max(x, border) - border, image.width - 1);
+                memcpy(dst + x * 4, image.pixels.data() + ((size_t)srcY * image.width + srcX) * 4, 4);
+            }
+        }
+    }
+};
+}
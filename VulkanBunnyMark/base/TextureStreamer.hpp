@@ -0,0 +1,338 @@
+/*
+* Background texture streaming
+*
+* Textures are requested by file name and decoded on worker threads: PNG files with stb_image and a CPU
+* built mip chain, baked .vkt files by selecting the payload for the device. Workers write the texels
+* straight to staging buffers, update() records the copies for the transfer queue and polls the fences
+* (or the timeline of the transfer queue, see VulkanDevice::timeline()) of earlier submissions, so neither decoding nor uploading blocks the thread that renders. Callers keep
+* drawing with a placeholder until the handle of a texture reports ready.
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BakedTexture.hpp"
+#include "ThreadPool.hpp"
+#include "VulkanBuffer.hpp"
+#include "VulkanInitializers.hpp"
+#include "VulkanTexture.hpp"
+
+namespace vks {
+
+class TextureStreamer {
+public:
+    typedef uint32_t Handle;
+
+    enum class State { decoding, decoded, uploading, ready, failed };
+
+    /**
+    * @param transferQueue Queue of the transfer family (queueFamilyIndices.transfer), only used by update()
+    * @param threadCount Decode workers, 0 selects one less than the hardware threads
+    */
+    TextureStreamer(vks::VulkanDevice* vdevice, VkQueue transferQueue, uint32_t threadCount = 0)
+        : device(vdevice), queue(transferQueue), timeline(vdevice->timeline(transferQueue)), workers(workerCount(threadCount))
+    {
+        commandPool = device->createCommandPool(device->queueFamilyIndices.transfer, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+        // Textures are sampled on the graphics queue, concurrent sharing saves the queue family ownership transfers
+        if (device->queueFamilyIndices.transfer != device->queueFamilyIndices.graphics) {
+            queueFamilies.push_back(device->queueFamilyIndices.graphics);
+            queueFamilies.push_back(device->queueFamilyIndices.transfer);
+        }
+    }
+
+    ~TextureStreamer()
+    {
+        // Workers still write to their entries
+        workers.wait();
+        for (auto& upload : uploads) {
+            if (timeline) {
+                timeline->wait(upload.value);
+            } else {
+                VK_CHECK(vkWaitForFences(*device, 1, &upload.fence, VK_TRUE, UINT64_MAX));
+            }
+            retire(upload);
+        }
+        for (auto& entry : entries) {
+            if (entry->state == State::ready) {
+                entry->texture.destroy();
+            }
+            entry->staging.destroy();
+        }
+        vkDestroyCommandPool(*device, commandPool, nullptr);
+    }
+
+    TextureStreamer(const TextureStreamer&) = delete;
+    TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+    /** @brief Queues a 2D texture (PNG or baked .vkt) for decoding and returns at once, PNG files get up to maxMipLevels levels of their mip chain */
+    Handle request(const std::string& filename, uint32_t maxMipLevels = UINT32_MAX)
+    {
+        entries.emplace_back(new Entry());
+        Entry* entry = entries.back().get();
+        entry->filename = filename;
+        entry->maxMipLevels = maxMipLevels;
+        entry->state = State::decoding;
+        workers.enqueue([this, entry] { decode(*entry); });
+        return (Handle)entries.size() - 1;
+    }
+
+    /**
+    * Submits the uploads of all textures decoded since the last call and marks those with finished uploads as ready
+    *
+    * Call once per frame from the thread that submits to the transfer queue, it never waits for the device
+    * @return Number of textures that became ready
+    */
+    uint32_t update()
+    {
+        uint32_t completed = 0;
+        for (size_t i = 0; i < uploads.size();) {
+            const bool done = timeline ? timeline->reached(uploads[i].value) : (vkGetFenceStatus(*device, uploads[i].fence) == VK_SUCCESS);
+            if (!done) {
+                i++;
+                continue;
+            }
+            completed += retire(uploads[i]);
+            uploads.erase(uploads.begin() + i);
+        }
+
+        // Everything decoded since the last call goes to the transfer queue with a single submit
+        Upload upload;
+        for (auto& entry : entries) {
+            if (entry->state != State::decoded) {
+                continue;
+            }
+            if (upload.commandBuffer == VK_NULL_HANDLE) {
+                VkCommandBufferAllocateInfo allocInfo = vks::initializers::commandBufferAllocateInfo(commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
+                VK_CHECK(vkAllocateCommandBuffers(*device, &allocInfo, &upload.commandBuffer));
+                VkCommandBufferBeginInfo beginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+                beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+                VK_CHECK(vkBeginCommandBuffer(upload.commandBuffer, &beginInfo));
+            }
+            record(*entry, upload.commandBuffer);
+            entry->state = State::uploading;
+            upload.entries.push_back(entry.get());
+        }
+        if (upload.commandBuffer != VK_NULL_HANDLE) {
+            VK_CHECK(vkEndCommandBuffer(upload.commandBuffer));
+            VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+            submitInfo.commandBufferCount = 1;
+            submitInfo.pCommandBuffers = &upload.commandBuffer;
+            if (timeline) {
+                upload.value = timeline->submit(submitInfo);
+            } else {
+                VkFenceCreateInfo fenceInfo = vks::initializers::fenceCreateInfo();
+                VK_CHECK(vkCreateFence(*device, &fenceInfo, nullptr, &upload.fence));
+                VK_CHECK(vkQueueSubmit(queue, 1, &submitInfo, upload.fence));
+            }
+            uploads.push_back(upload);
+        }
+        return completed;
+    }
+
+    State state(Handle handle) const { return entries[handle]->state; }
+    bool isReady(Handle handle) const { return state(handle) == State::ready; }
+    const std::string& filename(Handle handle) const { return entries[handle]->filename; }
+
+    /** @brief Texture of a handle, only valid once it is ready and owned by the streamer */
+    const vks::Texture& texture(Handle handle) const
+    {
+        assert(isReady(handle));
+        return entries[handle]->texture;
+    }
+
+    /** @brief Reads the size of a PNG or baked texture from its header without decoding it */
+    static bool querySize(const std::string& filename, uint32_t& width, uint32_t& height)
+    {
+        baked::MappedFile file;
+        if (!file.open(filename)) {
+            return false;
+        }
+        if (isBaked(file)) {
+            baked::Header header;
+            memcpy(&header, file.data(), sizeof(baked::Header));
+            width = header.width;
+            height = header.height;
+            return true;
+        }
+        int w, h, comp;
+        if (!stbi_info_from_memory(file.data(), (int)file.size(), &w, &h, &comp)) {
+            return false;
+        }
+        width = (uint32_t)w;
+        height = (uint32_t)h;
+        return true;
+    }
+
+private:
+    struct Entry {
+        std::string filename;
+        uint32_t maxMipLevels;
+        std::atomic<State> state;
+        // Written by the decode worker before the state becomes decoded
+        VkFormat format;
+        uint32_t width;
+        uint32_t height;
+        uint32_t mipLevels;
+        std::vector<VkBufferImageCopy> regions;
+        vks::Buffer staging;
+        vks::Texture texture;
+    };
+
+    struct Upload {
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        VkFence fence = VK_NULL_HANDLE;
+        // Transfer timeline value of the submission if the queue has a timeline, the fence otherwise
+        uint64_t value = 0;
+        std::vector<Entry*> entries;
+    };
+
+    vks::VulkanDevice* device;
+    VkQueue queue;
+    vks::TimelineSemaphore* timeline;
+    VkCommandPool commandPool;
+    std::vector<uint32_t> queueFamilies;
+    std::vector<std::unique_ptr<Entry>> entries;
+    std::vector<Upload> uploads;
+    vks::ThreadPool workers;
+
+    static uint32_t workerCount(uint32_t threadCount)
+    {
+        if (threadCount == 0) {
+            uint32_t hw = std::thread::hardware_concurrency();
+            threadCount = hw > 1 ? hw - 1 : 1;
+        }
+        return threadCount;
+    }
+
+    static bool isBaked(const baked::MappedFile& file)
+    {
+        uint32_t fileMagic = 0;
+        if (file.size() >= sizeof(baked::Header)) {
+            memcpy(&fileMagic, file.data(), sizeof(fileMagic));
+        }
+        return fileMagic == baked::magic;
+    }
+
+    // Runs on a worker thread
+    void decode(Entry& entry)
+    {
+        baked::MappedFile file;
+        bool decoded = false;
+        if (file.open(entry.filename)) {
+            decoded = isBaked(file) ? decodeBaked(file, entry) : decodeImage(file, entry);
+        }
+        entry.state = decoded ? State::decoded : State::failed;
+    }
+
+    bool decodeBaked(const baked::MappedFile& file, Entry& entry)
+    {
+        baked::Selection selection;
+        if (!baked::select(file, VK_IMAGE_VIEW_TYPE_2D, device, selection)) {
+            return false;
+        }
+        entry.format = selection.format;
+        entry.width = selection.header.width;
+        entry.height = selection.header.height;
+        entry.mipLevels = selection.header.mipLevels;
+        entry.regions.swap(selection.regions);
+        stage(entry, selection.data, selection.size);
+        return true;
+    }
+
+    bool decodeImage(const baked::MappedFile& file, Entry& entry)
+    {
+        int w, h, comp;
+        stbi_uc* pixels = stbi_load_from_memory(file.data(), (int)file.size(), &w, &h, &comp, STBI_rgb_alpha);
+        if (!pixels) {
+            return false;
+        }
+        if ((uint32_t)std::max(w, h) > device->properties.limits.maxImageDimension2D) {
+            stbi_image_free(pixels);
+            return false;
+        }
+        entry.format = VK_FORMAT_R8G8B8A8_UNORM;
+        entry.width = (uint32_t)w;
+        entry.height = (uint32_t)h;
+        // The whole chain is built here, with the same filter as Texture2D::fromBuffer
+        entry.mipLevels = std::max(1u, std::min(entry.maxMipLevels, Texture::mipLevelCount(entry.width, entry.height)));
+        std::vector<uint8_t> texels = Texture::buildMipChain(pixels, entry.width, entry.height, entry.mipLevels);
+        stbi_image_free(pixels);
+
+        VkDeviceSize offset = 0;
+        for (uint32_t level = 0; level < entry.mipLevels; level++) {
+            VkBufferImageCopy region = {};
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.mipLevel = level;
+            region.imageSubresource.baseArrayLayer = 0;
+            region.imageSubresource.layerCount = 1;
+            region.imageExtent.width = std::max(1u, entry.width >> level);
+            region.imageExtent.height = std::max(1u, entry.height >> level);
+            region.imageExtent.depth = 1;
+            region.bufferOffset = offset;
+            entry.regions.push_back(region);
+            offset += (VkDeviceSize)region.imageExtent.width * region.imageExtent.height * 4;
+        }
+        stage(entry, texels.data(), texels.size());
+        return true;
+    }
+
+    // VMA allocations are internally synchronized, staging buffers are created by the workers
+    void stage(Entry& entry, const void* data, VkDeviceSize size)
+    {
+        entry.staging.create(device, vks::BufferType::staging, 0, size, true);
+        memcpy(entry.staging.mappedData, data, (size_t)size);
+    }
+
+    // Only transfer stages and accesses are used, dedicated transfer queues support nothing else
+    void record(Entry& entry, VkCommandBuffer commandBuffer)
+    {
+        vks::Texture& texture = entry.texture;
+        texture.createImage(entry.format, entry.width, entry.height, 1, entry.mipLevels,
+            VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, device, queueFamilies);
+
+        VkImageMemoryBarrier barrier = vks::initializers::imageMemoryBarrier();
+        barrier.image = texture.image;
+        barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, entry.mipLevels, 0, 1 };
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        vkCmdCopyBufferToImage(commandBuffer, entry.staging.buffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            static_cast<uint32_t>(entry.regions.size()), entry.regions.data());
+
+        // The graphics queue only samples the texture after update() has seen this submission complete
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = 0;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = texture.imageLayout;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        texture.createView(entry.format, VK_IMAGE_VIEW_TYPE_2D);
+    }
+
+    uint32_t retire(Upload& upload)
+    {
+        for (Entry* entry : upload.entries) {
+            entry->staging.destroy();
+            entry->regions.clear();
+            entry->state = State::ready;
+        }
+        vkDestroyFence(*device, upload.fence, nullptr);
+        vkFreeCommandBuffers(*device, commandPool, 1, &upload.commandBuffer);
+        return (uint32_t)upload.entries.size();
+    }
+};
+}
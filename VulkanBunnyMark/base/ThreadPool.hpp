@@ -0,0 +1,139 @@
+/*
+* Simple persistent worker thread pool
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vks {
+
+class ThreadPool {
+public:
+    /** @brief Creates threadCount workers, 0 selects one worker less than the hardware threads (the caller is the last one) */
+    ThreadPool(uint32_t threadCount = 0)
+    {
+        if (threadCount == 0) {
+            uint32_t hw = std::thread::hardware_concurrency();
+            threadCount = hw > 1 ? hw - 1 : 0;
+        }
+        for (uint32_t i = 0; i < threadCount; i++) {
+            workers.emplace_back(&ThreadPool::workerLoop, this);
+        }
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeup.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    uint32_t size() const { return (uint32_t)workers.size(); }
+
+    /** @brief Queues a task for any worker, use wait() to block until all queued tasks have finished */
+    void enqueue(std::function<void()> task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push_back(std::move(task));
+            pending++;
+        }
+        wakeup.notify_one();
+    }
+
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [this] { return pending == 0; });
+    }
+
+    /**
+    * Calls func(i) for every i in [0, count) spread over the workers and the calling thread
+    *
+    * @note Blocks until all invocations returned, must not be called from a worker
+    */
+    void parallelFor(uint32_t count, const std::function<void(uint32_t)>& func)
+    {
+        if (count == 0) {
+            return;
+        }
+        uint32_t helpers = std::min(size(), count - 1);
+        if (helpers == 0) {
+            for (uint32_t i = 0; i < count; i++) {
+                func(i);
+            }
+            return;
+        }
+        std::atomic<uint32_t> next(0);
+        auto drain = [&next, count, &func] {
+            for (uint32_t i = next++; i < count; i = next++) {
+                func(i);
+            }
+        };
+        // Completion is tracked locally so unrelated queued tasks don't delay the caller
+        uint32_t active = helpers;
+        std::condition_variable done;
+        for (uint32_t i = 0; i < helpers; i++) {
+            enqueue([this, &drain, &active, &done] {
+                drain();
+                std::lock_guard<std::mutex> lock(mutex);
+                active--;
+                done.notify_all();
+            });
+        }
+        drain();
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [&active] { return active == 0; });
+    }
+
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    std::condition_variable finished;
+    uint32_t pending = 0;
+    bool stopping = false;
+
+    void workerLoop()
+    {
+        for (;;) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wakeup.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (stopping && tasks.empty()) {
+                    return;
+                }
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                pending--;
+            }
+            finished.notify_all();
+        }
+    }
+};
+}
@@ -0,0 +1,144 @@
+/*
+* Timeline semaphore paired with a queue
+*
+* A timeline semaphore (Vulkan 1.2) holds a 64 bit counter that only ever grows. Every submission through submit()
+* signals the next value, so "the GPU is done with a resource" becomes "the counter has reached the value of the last
+* submission that used it". One semaphore replaces a fence per frame or upload, host waits cover exactly the work they
+* need instead of a whole queue, and submissions to other queues can wait on the same values.
+*
+* Values have to be signaled in the order they execute, so a timeline only takes submissions to the queue it is
+* paired with. Like the queue itself it must not be used from two threads at once.
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "VulkanTools.h"
+#include "volk/volk.h"
+
+namespace vks {
+
+class TimelineSemaphore {
+public:
+    VkSemaphore semaphore = VK_NULL_HANDLE;
+    /** @brief Queue whose submissions signal the timeline */
+    VkQueue queue = VK_NULL_HANDLE;
+
+    void create(VkDevice device_, VkQueue queue_)
+    {
+        device = device_;
+        queue = queue_;
+        // volk's headers predate Vulkan 1.2 and only load the KHR aliases, which the device doesn't expose unless the
+        // extension is enabled, so the core entry points are looked up directly
+        getCounterValue = (PFN_vkGetSemaphoreCounterValueKHR)vkGetDeviceProcAddr(device, "vkGetSemaphoreCounterValue");
+        waitSemaphores = (PFN_vkWaitSemaphoresKHR)vkGetDeviceProcAddr(device, "vkWaitSemaphores");
+        VkSemaphoreTypeCreateInfo typeInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO };
+        typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+        typeInfo.initialValue = 0;
+        VkSemaphoreCreateInfo semaphoreInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
+        semaphoreInfo.pNext = &typeInfo;
+        VK_CHECK(vkCreateSemaphore(device, &semaphoreInfo, nullptr, &semaphore));
+    }
+
+    void destroy()
+    {
+        if (semaphore != VK_NULL_HANDLE) {
+            vkDestroySemaphore(device, semaphore, nullptr);
+            semaphore = VK_NULL_HANDLE;
+        }
+    }
+
+    /** @brief Makes the next submit() wait at the given stages until another timeline has reached a value */
+    void waitFor(const TimelineSemaphore& other, uint64_t value, VkPipelineStageFlags stages)
+    {
+        // Every timeline starts at 0
+        if (value > 0) {
+            pendingWaits.push_back(other.semaphore);
+            pendingWaitValues.push_back(value);
+            pendingWaitStages.push_back(stages);
+        }
+    }
+
+    /**
+    * Submits to the paired queue, in addition to the semaphores of the submit info the timeline is signaled
+    *
+    * @return Value the timeline reaches once the submission has completed
+    */
+    uint64_t submit(const VkSubmitInfo& submitInfo, VkFence fence = VK_NULL_HANDLE)
+    {
+        std::vector<VkSemaphore> waitSemaphores(submitInfo.pWaitSemaphores, submitInfo.pWaitSemaphores + submitInfo.waitSemaphoreCount);
+        std::vector<VkPipelineStageFlags> waitStages(submitInfo.pWaitDstStageMask, submitInfo.pWaitDstStageMask + submitInfo.waitSemaphoreCount);
+        std::vector<uint64_t> waitValues(waitSemaphores.size(), 0);
+        waitSemaphores.insert(waitSemaphores.end(), pendingWaits.begin(), pendingWaits.end());
+        waitStages.insert(waitStages.end(), pendingWaitStages.begin(), pendingWaitStages.end());
+        waitValues.insert(waitValues.end(), pendingWaitValues.begin(), pendingWaitValues.end());
+        pendingWaits.clear();
+        pendingWaitValues.clear();
+        pendingWaitStages.clear();
+
+        std::vector<VkSemaphore> signalSemaphores(submitInfo.pSignalSemaphores, submitInfo.pSignalSemaphores + submitInfo.signalSemaphoreCount);
+        signalSemaphores.push_back(semaphore);
+        // Values of binary semaphores are ignored
+        std::vector<uint64_t> signalValues(signalSemaphores.size(), 0);
+        signalValues.back() = lastSubmitted + 1;
+
+        VkTimelineSemaphoreSubmitInfo timelineInfo = { VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO };
+        timelineInfo.waitSemaphoreValueCount = (uint32_t)waitValues.size();
+        timelineInfo.pWaitSemaphoreValues = waitValues.data();
+        timelineInfo.signalSemaphoreValueCount = (uint32_t)signalValues.size();
+        timelineInfo.pSignalSemaphoreValues = signalValues.data();
+        VkSubmitInfo timelineSubmitInfo = submitInfo;
+        timelineSubmitInfo.pNext = &timelineInfo;
+        timelineSubmitInfo.waitSemaphoreCount = (uint32_t)waitSemaphores.size();
+        timelineSubmitInfo.pWaitSemaphores = waitSemaphores.data();
+        timelineSubmitInfo.pWaitDstStageMask = waitStages.data();
+        timelineSubmitInfo.signalSemaphoreCount = (uint32_t)signalSemaphores.size();
+        timelineSubmitInfo.pSignalSemaphores = signalSemaphores.data();
+        VK_CHECK(vkQueueSubmit(queue, 1, &timelineSubmitInfo, fence));
+        return ++lastSubmitted;
+    }
+
+    /** @brief Value signaled by the last submission, reached once everything submitted so far has completed */
+    uint64_t submitted() const { return lastSubmitted; }
+
+    /** @brief Checks without blocking whether the timeline has reached the value */
+    bool reached(uint64_t value)
+    {
+        if (value > lastCompleted) {
+            VK_CHECK(getCounterValue(device, semaphore, &lastCompleted));
+        }
+        return value <= lastCompleted;
+    }
+
+    /** @brief Blocks until the timeline has reached the value */
+    void wait(uint64_t value)
+    {
+        if (value <= lastCompleted) {
+            return;
+        }
+        VkSemaphoreWaitInfo waitInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO };
+        waitInfo.semaphoreCount = 1;
+        waitInfo.pSemaphores = &semaphore;
+        waitInfo.pValues = &value;
+        VK_CHECK(waitSemaphores(device, &waitInfo, UINT64_MAX));
+        lastCompleted = value;
+    }
+
+private:
+    VkDevice device = VK_NULL_HANDLE;
+    PFN_vkGetSemaphoreCounterValueKHR getCounterValue = nullptr;
+    PFN_vkWaitSemaphoresKHR waitSemaphores = nullptr;
+    uint64_t lastSubmitted = 0;
+    // Highest value seen on the device, saves querying the counter for values known to be reached
+    uint64_t lastCompleted = 0;
+    // Waits added by waitFor() for the next submit()
+    std::vector<VkSemaphore> pendingWaits;
+    std::vector<uint64_t> pendingWaitValues;
+    std::vector<VkPipelineStageFlags> pendingWaitStages;
+};
+
+}
@@ -34,7 +34,9 @@ struct Buffer {
     BufferType bufferType;
     VkMemoryPropertyFlags memoryFlags;
 
-    void create(vks::VulkanDevice* vulkanDevice, BufferType bufferType, VkBufferUsageFlags usage, VkDeviceSize size, bool persistentMapped = false)
+    // With more than one queue family the buffer is shared concurrently and needs no ownership transfers between them
+    void create(vks::VulkanDevice* vulkanDevice, BufferType bufferType, VkBufferUsageFlags usage, VkDeviceSize size, bool persistentMapped = false,
+        const std::vector<uint32_t>& queueFamilies = std::vector<uint32_t>())
     {
         if (buffer) destroy();
         vdevice = vulkanDevice;
@@ -43,6 +45,11 @@ struct Buffer {
         VkBufferCreateInfo bufferInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
         bufferInfo.size = size;
         bufferInfo.usage = usage;
+        if (queueFamilies.size() > 1) {
+            bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+            bufferInfo.queueFamilyIndexCount = (uint32_t)queueFamilies.size();
+            bufferInfo.pQueueFamilyIndices = queueFamilies.data();
+        }
         VmaAllocationCreateInfo allocCreateInfo = {};
         switch (bufferType) {
         case BufferType::device:
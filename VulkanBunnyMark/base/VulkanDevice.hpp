@@ -10,6 +10,7 @@
 
 #pragma once
 
+#include "TimelineSemaphore.hpp"
 #include "VulkanBuffer.hpp"
 #include "VulkanTools.h"
 #include "volk/volk.h"
@@ -37,6 +38,8 @@ struct VulkanDevice {
     std::vector<VkQueueFamilyProperties> queueFamilyProperties;
     /** @brief List of extensions supported by the device */
     std::vector<std::string> supportedExtensions;
+    /** @brief Timeline semaphores of the queues that have one, owned by the application, see timeline() */
+    std::vector<vks::TimelineSemaphore*> timelines;
 
     /** @brief Default command pool for the graphics queue family index */
     VkCommandPool commandPool = VK_NULL_HANDLE;
@@ -377,7 +380,7 @@ struct VulkanDevice {
 		* @param free (Optional) Free the command buffer once it has been submitted (Defaults to true)
 		*
 		* @note The queue that the command buffer is submitted to must be from the same family index as the pool it was allocated from
-		* @note Uses a fence to ensure command buffer has finished executing
+		* @note Uses the timeline of the queue or a fence to ensure command buffer has finished executing
 		*/
     void flushCommandBuffer(VkCommandBuffer commandBuffer, VkQueue queue, bool free = true)
     {
@@ -391,6 +394,15 @@ struct VulkanDevice {
         submitInfo.commandBufferCount = 1;
         submitInfo.pCommandBuffers = &commandBuffer;
 
+        // A queue with a timeline waits for the value of this submission instead of a fence
+        if (vks::TimelineSemaphore* queueTimeline = timeline(queue)) {
+            queueTimeline->wait(queueTimeline->submit(submitInfo));
+            if (free) {
+                vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+            }
+            return;
+        }
+
         // Create fence to ensure that the command buffer has finished executing
         VkFenceCreateInfo fenceInfo = vks::initializers::fenceCreateInfo(VK_FLAGS_NONE);
         VkFence fence;
@@ -408,6 +420,17 @@ struct VulkanDevice {
         }
     }
 
+    /** @brief Timeline semaphore signaled by submissions to the queue, nullptr if the queue doesn't have one */
+    vks::TimelineSemaphore* timeline(VkQueue queue)
+    {
+        for (vks::TimelineSemaphore* queueTimeline : timelines) {
+            if (queueTimeline->queue == queue) {
+                return queueTimeline;
+            }
+        }
+        return nullptr;
+    }
+
     /**
 		* Check if an extension is supported by the (physical device)
 		*
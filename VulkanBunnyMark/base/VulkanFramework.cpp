@@ -7,6 +7,7 @@
 */
 
 #include "VulkanFramework.h"
+#include "ShaderRegistry.hpp"
 
 std::vector<const char*> VulkanFramework::args;
 
@@ -19,6 +20,15 @@ VkResult VulkanFramework::createInstance(bool enableValidation)
     settings.validation = true;
 #endif
 
+    // Timeline semaphores are core in Vulkan 1.2, request it if the loader supports it
+    if (settings.timelineSemaphores && (apiVersion < VK_API_VERSION_1_2) && (vkEnumerateInstanceVersion != nullptr)) {
+        uint32_t instanceVersion = VK_API_VERSION_1_0;
+        VK_CHECK(vkEnumerateInstanceVersion(&instanceVersion));
+        if (instanceVersion >= VK_API_VERSION_1_2) {
+            apiVersion = VK_API_VERSION_1_2;
+        }
+    }
+
     VkApplicationInfo appInfo = { VK_STRUCTURE_TYPE_APPLICATION_INFO };
     appInfo.pApplicationName = name.c_str();
     appInfo.pEngineName = name.c_str();
@@ -31,6 +41,8 @@ VkResult VulkanFramework::createInstance(bool enableValidation)
     instanceExtensions.push_back(VK_KHR_WIN32_SURFACE_EXTENSION_NAME);
 #elif defined(VK_USE_PLATFORM_ANDROID_KHR)
     instanceExtensions.push_back(VK_KHR_ANDROID_SURFACE_EXTENSION_NAME);
+#elif defined(VK_USE_PLATFORM_XCB_KHR)
+    instanceExtensions.push_back(VK_KHR_XCB_SURFACE_EXTENSION_NAME);
 #elif defined(VK_USE_PLATFORM_IOS_MVK)
     instanceExtensions.push_back(VK_MVK_IOS_SURFACE_EXTENSION_NAME);
 #elif defined(VK_USE_PLATFORM_MACOS_MVK)
@@ -85,6 +97,9 @@ std::string VulkanFramework::getWindowTitle()
     windowTitle = title + " - " + device;
     if (!settings.overlay) {
         windowTitle += " - " + std::to_string(frameCounter) + " fps";
+        if (swapChain.presentMode != VK_PRESENT_MODE_MAX_ENUM_KHR) {
+            windowTitle += " - " + vks::tools::presentModeString(swapChain.presentMode);
+        }
     }
     return windowTitle;
 }
@@ -95,6 +110,9 @@ const std::string VulkanFramework::getAssetPath()
 {
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
     return "";
+#elif defined(VKS_ASSET_PATH)
+    // Set by the CMake build, whose binaries don't live next to data/
+    return VKS_ASSET_PATH;
 #else
     return "./../data/";
 #endif
@@ -106,6 +124,7 @@ void VulkanFramework::createCommandBuffers()
     // Create one command buffer for each swap chain image and reuse for rendering
     drawCmdBuffers.resize(swapChain.imageCount);
     drawCmdBuffersValid.resize(swapChain.imageCount, false);
+    drawCmdBufferValues.resize(swapChain.imageCount, 0);
 
     VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(
         cmdPool,
@@ -123,9 +142,35 @@ void VulkanFramework::destroyCommandBuffers()
 
 void VulkanFramework::invalidateCommandBuffers()
 {
+    // The render thread records every frame, and owns the command buffers
+    if (settings.renderThread) {
+        return;
+    }
     std::fill(drawCmdBuffersValid.begin(), drawCmdBuffersValid.end(), false);
 }
 
+void VulkanFramework::waitForDrawCmdBuffer(uint32_t index)
+{
+    if (settings.timelineSemaphores) {
+        timelines.frame.wait(drawCmdBufferValues[index]);
+        return;
+    }
+    VK_CHECK(vkWaitForFences(device, 1, &waitFences[index], VK_TRUE, UINT64_MAX));
+    VK_CHECK(vkResetFences(device, 1, &waitFences[index]));
+}
+
+uint64_t VulkanFramework::submitDrawCmdBuffer()
+{
+    submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
+    submitInfo.commandBufferCount = 1;
+    if (settings.timelineSemaphores) {
+        drawCmdBufferValues[currentBuffer] = timelines.frame.submit(submitInfo);
+        return drawCmdBufferValues[currentBuffer];
+    }
+    VK_CHECK(vkQueueSubmit(queue, 1, &submitInfo, waitFences[currentBuffer]));
+    return 0;
+}
+
 VkCommandBuffer VulkanFramework::createCommandBuffer(VkCommandBufferLevel level, bool begin)
 {
     VkCommandBuffer cmdBuffer;
@@ -154,8 +199,13 @@ void VulkanFramework::flushCommandBuffer(VkCommandBuffer commandBuffer, VkQueue
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &commandBuffer;
 
-    VK_CHECK(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
-    VK_CHECK(vkQueueWaitIdle(queue));
+    // A timeline only waits for this submission instead of everything on the queue
+    if (vks::TimelineSemaphore* queueTimeline = vulkanDevice->timeline(queue)) {
+        queueTimeline->wait(queueTimeline->submit(submitInfo));
+    } else {
+        VK_CHECK(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+        VK_CHECK(vkQueueWaitIdle(queue));
+    }
 
     if (free) {
         vkFreeCommandBuffers(device, cmdPool, 1, &commandBuffer);
@@ -196,11 +246,22 @@ VkPipelineShaderStageCreateInfo VulkanFramework::loadShader(std::string fileName
 {
     VkPipelineShaderStageCreateInfo shaderStage = { VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO };
     shaderStage.stage = stage;
+    // Shaders embedded at build time are looked up by their path below the shader directory, the file is only read if there is none
+    const std::string shaderPath = getAssetPath() + "shaders/";
+    const vks::shaders::Shader* embedded = nullptr;
+    if (fileName.compare(0, shaderPath.size(), shaderPath) == 0) {
+        embedded = vks::shaders::find(fileName.substr(shaderPath.size()));
+    }
+    if (embedded) {
+        shaderStage.module = vks::tools::createShaderModule(embedded->code, embedded->size, device);
+    }
+    else {
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
-    shaderStage.module = vks::tools::loadShader(androidApp->activity->assetManager, fileName.c_str(), device);
+        shaderStage.module = vks::tools::loadShader(androidApp->activity->assetManager, fileName.c_str(), device);
 #else
-    shaderStage.module = vks::tools::loadShader(fileName.c_str(), device);
+        shaderStage.module = vks::tools::loadShader(fileName.c_str(), device);
 #endif
+    }
     shaderStage.pName = "main"; // todo : make param
     assert(shaderStage.module != VK_NULL_HANDLE);
     shaderModules.push_back(shaderStage.module);
@@ -216,10 +277,31 @@ void VulkanFramework::renderFrame()
     }
 
     render();
+    if (renderThread.joinable()) {
+        // The render thread blocks once it has acquired the next image, until then it may still use the last frame's state
+        framePacer.beginWait();
+        std::unique_lock<std::mutex> lock(renderMutex);
+        renderCondition.wait(lock, [this] { return renderParked; });
+        framePacer.endWait();
+        // Width and height are only stable while the render thread is blocked
+        if (swapChainResized) {
+            swapChainResized = false;
+            applyResize();
+        }
+        publishThreadedFrame();
+        // ImGui and the overlay buffers are only touched here while the render thread is blocked
+        updateOverlay();
+        // Not parked any more as far as the next frame is concerned, even before the render thread wakes up
+        renderParked = false;
+        framePublished = true;
+        lock.unlock();
+        renderCondition.notify_all();
+    }
     frameCounter++;
     auto tEnd = std::chrono::high_resolution_clock::now();
     auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
-    frameDeltaTime = (float)tDiff / 1000.0f;
+    // Time spent waiting for the frame slot is part of the frame
+    frameDeltaTime = (float)(tDiff / 1000.0 + framePacer.waited());
     camera.update(frameDeltaTime);
     if (camera.moving()) {
         viewUpdated = true;
@@ -238,12 +320,55 @@ void VulkanFramework::renderFrame()
             std::string windowTitle = getWindowTitle();
             SetWindowText(window, windowTitle.c_str());
         }
+#elif defined(VK_USE_PLATFORM_XCB_KHR)
+        if (!settings.overlay) {
+            std::string windowTitle = getWindowTitle();
+            xcb_change_property(connection, XCB_PROP_MODE_REPLACE, window, XCB_ATOM_WM_NAME, XCB_ATOM_STRING, 8, (uint32_t)windowTitle.size(), windowTitle.c_str());
+            xcb_flush(connection);
+        }
 #endif
         frameCounter = 0;
         lastTimestamp = tEnd;
     }
     // TODO: Cap UI overlay update rates
-    updateOverlay();
+    if (!renderThread.joinable()) {
+        updateOverlay();
+    }
+}
+
+void VulkanFramework::renderThreadLoop()
+{
+    bool resize = false;
+    for (;;) {
+        if (resize) {
+            resizeSwapChain();
+        }
+        beginThreadedFrame();
+        std::unique_lock<std::mutex> lock(renderMutex);
+        renderParked = true;
+        renderCondition.notify_all();
+        renderCondition.wait(lock, [this] { return framePublished || renderStop; });
+        if (!framePublished) {
+            break;
+        }
+        framePublished = false;
+        resize = resizePending;
+        lock.unlock();
+        endThreadedFrame();
+    }
+}
+
+void VulkanFramework::stopRenderThread()
+{
+    if (!renderThread.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(renderMutex);
+        renderStop = true;
+    }
+    renderCondition.notify_all();
+    renderThread.join();
 }
 
 void VulkanFramework::renderLoop()
@@ -251,17 +376,44 @@ void VulkanFramework::renderLoop()
     destWidth = width;
     destHeight = height;
     lastTimestamp = std::chrono::high_resolution_clock::now();
+#if !defined(VK_USE_PLATFORM_ANDROID_KHR)
+    if (settings.renderThread) {
+        renderThread = std::thread(&VulkanFramework::renderThreadLoop, this);
+    }
+#endif
 #if defined(_WIN32)
     MSG msg = { 0 };
     while (WM_QUIT != msg.message) {
-        if (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
+        framePacer.beginFrame();
+        while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
             TranslateMessage(&msg);
             DispatchMessage(&msg);
+            if (msg.message == WM_QUIT) {
+                break;
+            }
         }
-        else {
+        if (WM_QUIT != msg.message) {
             renderFrame();
         }
     }
+#elif defined(VK_USE_PLATFORM_XCB_KHR)
+    xcb_flush(connection);
+    while (!quit) {
+        framePacer.beginFrame();
+        // Only the first poll may read from the socket, and only if nothing is queued yet (e.g. by the presentation engine
+        // sharing the connection). Everything that arrived with that read is drained from the queue without further syscalls,
+        // so a frame costs at most one non-blocking read no matter how many events are pending.
+        xcb_generic_event_t* event = xcb_poll_for_event(connection);
+        while (event) {
+            handleEvent(event);
+            free(event);
+            event = xcb_poll_for_queued_event(connection);
+        }
+        if (xcb_connection_has_error(connection)) {
+            break;
+        }
+        renderFrame();
+    }
 #elif defined(VK_USE_PLATFORM_ANDROID_KHR)
     while (1) {
         int ident;
@@ -271,6 +423,7 @@ void VulkanFramework::renderLoop()
 
         focused = true;
 
+        framePacer.beginFrame();
         while ((ident = ALooper_pollAll(focused ? 0 : -1, NULL, &events, (void**)&source)) >= 0) {
             if (source != NULL) {
                 source->process(androidApp, source);
@@ -296,7 +449,7 @@ void VulkanFramework::renderLoop()
             frameCounter++;
             auto tEnd = std::chrono::high_resolution_clock::now();
             auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
-            frameDeltaTime = tDiff / 1000.0f;
+            frameDeltaTime = tDiff / 1000.0f + framePacer.waited();
             camera.update(frameDeltaTime);
             // Convert to clamped timer value
             if (!paused) {
@@ -359,6 +512,7 @@ void VulkanFramework::renderLoop()
         }
     }
 #endif
+    stopRenderThread();
     // Flush device to make sure all resources can be freed
     if (device != VK_NULL_HANDLE) {
         vkDeviceWaitIdle(device);
@@ -387,6 +541,8 @@ void VulkanFramework::updateOverlay()
     ImGui::Begin(title.c_str(), nullptr, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove);
     ImGui::TextUnformatted(deviceProperties.deviceName);
     ImGui::Text("%.2f ms/frame (%.1d fps)", (1000.0f / lastFPS), lastFPS);
+    ImGui::Text("%s, %d images", vks::tools::presentModeString(swapChain.presentMode).c_str(), swapChain.imageCount);
+    ImGui::Text("%.2f ms input latency%s", framePacer.inputLatency(), framePacer.lowLatency ? " (low latency)" : "");
 
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
     ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(0.0f, 5.0f * UIOverlay.scale));
@@ -427,11 +583,25 @@ void VulkanFramework::drawUI(const VkCommandBuffer commandBuffer)
 
 void VulkanFramework::prepareFrame()
 {
+    destroyRetiredSwapChains(false);
+
     // Acquire the next image from the swap chain
+    // With a render thread the pacer only sees the main thread's wait for it
+    if (!settings.renderThread) {
+        framePacer.beginWait();
+    }
     VkResult result = swapChain.acquireNextImage(semaphores.presentComplete, &currentBuffer);
-    // Recreate the swapchain if it's no longer compatible with the surface (OUT_OF_DATE) or no longer optimal for presentation (SUBOPTIMAL)
-    if ((result == VK_ERROR_OUT_OF_DATE_KHR) || (result == VK_SUBOPTIMAL_KHR)) {
-        windowResize();
+    // Recreate the swapchain if it's no longer compatible with the surface (OUT_OF_DATE) and acquire from the new one
+    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+        resizeSwapChain();
+        result = swapChain.acquireNextImage(semaphores.presentComplete, &currentBuffer);
+    }
+    if (!settings.renderThread) {
+        framePacer.endWait();
+    }
+    // A swapchain that is no longer optimal for presentation (SUBOPTIMAL) still presents the acquired image, it's recreated after that
+    if (result == VK_SUBOPTIMAL_KHR) {
+        swapChainSuboptimal = true;
     } else {
         VK_CHECK(result);
     }
@@ -442,24 +612,34 @@ void VulkanFramework::submitFrame()
     // Present the current buffer to the swap chain
     // Pass the semaphore signaled by the command buffer submission from the submit info as the wait semaphore for swap chain presentation
     // This ensures that the image is not presented to the windowing system until all commands have been submitted
+    if (!settings.renderThread) {
+        framePacer.submitted();
+        framePacer.beginWait();
+    }
     VkResult result = swapChain.queuePresent(queue, currentBuffer, semaphores.renderComplete);
+    if (!settings.renderThread) {
+        framePacer.endWait();
+    }
     if (!((result == VK_SUCCESS) || (result == VK_SUBOPTIMAL_KHR))) {
         if (result == VK_ERROR_OUT_OF_DATE_KHR) {
             // Swap chain is no longer compatible with the surface and needs to be recreated
-            windowResize();
+            resizeSwapChain();
             return;
         } else {
             VK_CHECK(result);
         }
-    }    
+    }
+    if (swapChainSuboptimal) {
+        resizeSwapChain();
+    }
 }
 
 VulkanFramework::VulkanFramework(bool enableValidation)
 {
 #if !defined(VK_USE_PLATFORM_ANDROID_KHR)
-    // Check for a valid asset path
+    // Check for a valid asset path, builds with embedded shaders only need it for textures and report missing ones when loading them
     struct stat info;
-    if (stat(getAssetPath().c_str(), &info) != 0) {
+    if (vks::shaders::count() == 0 && stat(getAssetPath().c_str(), &info) != 0) {
 #if defined(_WIN32)
         std::string msg = "Could not locate asset path in \"" + getAssetPath() + "\" !";
         MessageBox(NULL, msg.c_str(), "Fatal error", MB_OK | MB_ICONERROR);
@@ -472,6 +652,13 @@ VulkanFramework::VulkanFramework(bool enableValidation)
 
     settings.validation = enableValidation;
 
+#if defined(VK_USE_PLATFORM_ANDROID_KHR)
+    // Hold 60 fps on high refresh rate displays and sleep through the whole wait to save power,
+    // set before parsing so -fps still overrides the target
+    framePacer.targetFps = 60.0f;
+    framePacer.spin = false;
+#endif
+
     char* numConvPtr;
 
     // Parse command line arguments
@@ -485,6 +672,41 @@ VulkanFramework::VulkanFramework(bool enableValidation)
         if ((args[i] == std::string("-f")) || (args[i] == std::string("--fullscreen"))) {
             settings.fullscreen = true;
         }
+        if ((args[i] == std::string("-present")) && (i + 1 < args.size())) {
+            const std::string mode(args[i + 1]);
+            if (mode == "fifo") {
+                settings.presentMode = VK_PRESENT_MODE_FIFO_KHR;
+            } else if (mode == "fifo_relaxed") {
+                settings.presentMode = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+            } else if (mode == "mailbox") {
+                settings.presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+            } else if (mode == "immediate") {
+                settings.presentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+            } else {
+                std::cerr << "Unknown present mode " << mode << ", expected fifo, fifo_relaxed, mailbox or immediate" << std::endl;
+            }
+        }
+        if ((args[i] == std::string("-fps")) && (i + 1 < args.size())) {
+            float fps = strtof(args[i + 1], &numConvPtr);
+            if (numConvPtr != args[i + 1]) {
+                framePacer.targetFps = fps;
+            };
+        }
+        if (args[i] == std::string("-lowlatency")) {
+            framePacer.lowLatency = true;
+        }
+        if (args[i] == std::string("-renderthread")) {
+            settings.renderThread = true;
+        }
+        if (args[i] == std::string("-timeline")) {
+            settings.timelineSemaphores = true;
+        }
+        if ((args[i] == std::string("-swapimages")) && (i + 1 < args.size())) {
+            uint32_t n = strtol(args[i + 1], &numConvPtr, 10);
+            if (numConvPtr != args[i + 1]) {
+                settings.swapImages = n;
+            };
+        }
         if ((args[i] == std::string("-w")) || (args[i] == std::string("-width"))) {
             uint32_t w = strtol(args[i + 1], &numConvPtr, 10);
             if (numConvPtr != args[i + 1]) {
@@ -508,12 +730,15 @@ VulkanFramework::VulkanFramework(bool enableValidation)
         setupConsole("Vulkan validation output");
     }
     setupDPIAwareness();
+#elif defined(VK_USE_PLATFORM_XCB_KHR)
+    initxcbConnection();
 #endif
 }
 
 VulkanFramework::~VulkanFramework()
 {
     // Clean up Vulkan resources
+    destroyRetiredSwapChains(true);
     swapChain.cleanup();
     if (descriptorPool != VK_NULL_HANDLE) {
         vkDestroyDescriptorPool(device, descriptorPool, nullptr);
@@ -540,6 +765,9 @@ VulkanFramework::~VulkanFramework()
     for (auto& fence : waitFences) {
         vkDestroyFence(device, fence, nullptr);
     }
+    timelines.frame.destroy();
+    timelines.transfer.destroy();
+    timelines.compute.destroy();
 
     if (settings.overlay) {
         UIOverlay.freeResources();
@@ -553,6 +781,14 @@ VulkanFramework::~VulkanFramework()
 
     vkDestroyInstance(instance, nullptr);
 
+#if defined(VK_USE_PLATFORM_XCB_KHR)
+    if (window != XCB_NONE) {
+        xcb_destroy_window(connection, window);
+    }
+    free(atom_wm_delete_window);
+    xcb_disconnect(connection);
+#endif
+
     // todo : android cleanup (if required)
 }
 
@@ -646,12 +882,20 @@ bool VulkanFramework::initVulkan()
 
     // Derived examples can override this to set actual features (based on above readings) to enable for logical device creation
     getEnabledFeatures();
+    if (settings.timelineSemaphores && !enableTimelineSemaphores()) {
+#if defined(VK_USE_PLATFORM_ANDROID_KHR)
+        LOGD("Timeline semaphores not supported, using fences");
+#else
+        std::cout << "Timeline semaphores not supported, using fences" << std::endl;
+#endif
+        settings.timelineSemaphores = false;
+    }
 
     // Vulkan device creation
     // This is handled by a separate class that gets a logical device representation
     // and encapsulates functions related to a device
     vulkanDevice = new vks::VulkanDevice(physicalDevice);
-    VkResult res = vulkanDevice->createLogicalDevice(enabledFeatures, enabledDeviceExtensions, deviceCreatepNextChain, true, VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT);
+    VkResult res = vulkanDevice->createLogicalDevice(enabledFeatures, enabledDeviceExtensions, deviceCreatepNextChain, true, VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT);
     if (res != VK_SUCCESS) {
         vks::tools::exitFatal("Could not create Vulkan device: \n" + vks::tools::errorString(res), res);
         return false;
@@ -663,6 +907,17 @@ bool VulkanFramework::initVulkan()
 
     // Get a graphics queue from the device
     vkGetDeviceQueue(device, vulkanDevice->queueFamilyIndices.graphics, 0, &queue);
+    vkGetDeviceQueue(device, vulkanDevice->queueFamilyIndices.transfer, 0, &transferQueue);
+    vkGetDeviceQueue(device, vulkanDevice->queueFamilyIndices.compute, 0, &computeQueue);
+    if (settings.timelineSemaphores) {
+        // Without dedicated families the timelines signal from the graphics queue, each in its own order
+        timelines.frame.create(device, queue);
+        timelines.transfer.create(device, transferQueue);
+        timelines.compute.create(device, computeQueue);
+        vulkanDevice->timelines.push_back(&timelines.frame);
+        vulkanDevice->timelines.push_back(&timelines.transfer);
+        vulkanDevice->timelines.push_back(&timelines.compute);
+    }
 
     // Find a suitable depth format
     VkBool32 validDepthFormat = vks::tools::getSupportedDepthFormat(physicalDevice, &depthFormat);
@@ -836,6 +1091,8 @@ void VulkanFramework::handleMessages(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM
     switch (uMsg) {
     case WM_CLOSE:
         prepared = false;
+        // Nothing may present to the window once it is gone
+        stopRenderThread();
         DestroyWindow(hWnd);
         PostQuitMessage(0);
         break;
@@ -929,7 +1186,7 @@ void VulkanFramework::handleMessages(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM
             if ((resizing) || ((wParam == SIZE_MAXIMIZED) || (wParam == SIZE_RESTORED))) {
                 destWidth = LOWORD(lParam);
                 destHeight = HIWORD(lParam);
-                windowResize();
+                requestResize();
             }
         }
         break;
@@ -1117,11 +1374,214 @@ void VulkanFramework::handleAppCommand(android_app* app, int32_t cmd)
         // Window is hidden or closed, clean up resources
         LOGD("APP_CMD_TERM_WINDOW");
         if (vulkanApp->prepared) {
+            vulkanApp->destroyRetiredSwapChains(true);
             vulkanApp->swapChain.cleanup();
         }
         break;
     }
 }
+#elif defined(VK_USE_PLATFORM_XCB_KHR)
+static inline xcb_intern_atom_reply_t* intern_atom_helper(xcb_connection_t* conn, bool only_if_exists, const char* str)
+{
+    xcb_intern_atom_cookie_t cookie = xcb_intern_atom(conn, only_if_exists, (uint16_t)strlen(str), str);
+    return xcb_intern_atom_reply(conn, cookie, NULL);
+}
+
+// Set up a window using XCB and request event types
+xcb_window_t VulkanFramework::setupWindow()
+{
+    uint32_t value_mask, value_list[32];
+
+    window = xcb_generate_id(connection);
+
+    value_mask = XCB_CW_BACK_PIXEL | XCB_CW_EVENT_MASK;
+    value_list[0] = screen->black_pixel;
+    value_list[1] = XCB_EVENT_MASK_KEY_RELEASE | XCB_EVENT_MASK_KEY_PRESS | XCB_EVENT_MASK_STRUCTURE_NOTIFY | XCB_EVENT_MASK_POINTER_MOTION | XCB_EVENT_MASK_BUTTON_PRESS | XCB_EVENT_MASK_BUTTON_RELEASE;
+
+    if (settings.fullscreen) {
+        width = destWidth = screen->width_in_pixels;
+        height = destHeight = screen->height_in_pixels;
+    }
+
+    xcb_create_window(connection,
+        XCB_COPY_FROM_PARENT,
+        window, screen->root,
+        0, 0, width, height, 0,
+        XCB_WINDOW_CLASS_INPUT_OUTPUT,
+        screen->root_visual,
+        value_mask, value_list);
+
+    // Get notified by the window manager when the window is closed instead of losing the connection
+    xcb_intern_atom_reply_t* reply = intern_atom_helper(connection, true, "WM_PROTOCOLS");
+    atom_wm_delete_window = intern_atom_helper(connection, false, "WM_DELETE_WINDOW");
+    if (reply && atom_wm_delete_window) {
+        xcb_change_property(connection, XCB_PROP_MODE_REPLACE, window, reply->atom, XCB_ATOM_ATOM, 32, 1, &atom_wm_delete_window->atom);
+    }
+    free(reply);
+
+    std::string windowTitle = getWindowTitle();
+    xcb_change_property(connection, XCB_PROP_MODE_REPLACE, window, XCB_ATOM_WM_NAME, XCB_ATOM_STRING, 8, (uint32_t)windowTitle.size(), windowTitle.c_str());
+
+    if (settings.fullscreen) {
+        xcb_intern_atom_reply_t* atom_wm_state = intern_atom_helper(connection, false, "_NET_WM_STATE");
+        xcb_intern_atom_reply_t* atom_wm_fullscreen = intern_atom_helper(connection, false, "_NET_WM_STATE_FULLSCREEN");
+        if (atom_wm_state && atom_wm_fullscreen) {
+            xcb_change_property(connection, XCB_PROP_MODE_REPLACE, window, atom_wm_state->atom, XCB_ATOM_ATOM, 32, 1, &atom_wm_fullscreen->atom);
+        }
+        free(atom_wm_fullscreen);
+        free(atom_wm_state);
+    }
+
+    xcb_map_window(connection, window);
+    xcb_flush(connection);
+
+    return window;
+}
+
+// Connect to the X server named by DISPLAY and pick its default screen
+void VulkanFramework::initxcbConnection()
+{
+    int scr;
+    connection = xcb_connect(NULL, &scr);
+    if (xcb_connection_has_error(connection)) {
+        vks::tools::exitFatal("Could not connect to the X server, is DISPLAY set?", -1);
+    }
+
+    const xcb_setup_t* setup = xcb_get_setup(connection);
+    xcb_screen_iterator_t iter = xcb_setup_roots_iterator(setup);
+    while (scr-- > 0) {
+        xcb_screen_next(&iter);
+    }
+    screen = iter.data;
+}
+
+void VulkanFramework::handleEvent(const xcb_generic_event_t* event)
+{
+    switch (event->response_type & 0x7f) {
+    case XCB_CLIENT_MESSAGE: {
+        const xcb_client_message_event_t* clientEvent = (const xcb_client_message_event_t*)event;
+        if (atom_wm_delete_window && (clientEvent->data.data32[0] == atom_wm_delete_window->atom)) {
+            quit = true;
+        }
+        break;
+    }
+    case XCB_MOTION_NOTIFY: {
+        const xcb_motion_notify_event_t* motion = (const xcb_motion_notify_event_t*)event;
+        handleMouseMove((int32_t)motion->event_x, (int32_t)motion->event_y);
+        break;
+    }
+    case XCB_BUTTON_PRESS: {
+        const xcb_button_press_event_t* press = (const xcb_button_press_event_t*)event;
+        mousePos = glm::vec2((float)press->event_x, (float)press->event_y);
+        switch (press->detail) {
+        case XCB_BUTTON_INDEX_1:
+            mouseButtons.left = true;
+            break;
+        case XCB_BUTTON_INDEX_2:
+            mouseButtons.middle = true;
+            break;
+        case XCB_BUTTON_INDEX_3:
+            mouseButtons.right = true;
+            break;
+        case XCB_BUTTON_INDEX_4:
+        case XCB_BUTTON_INDEX_5: {
+            // One wheel notch, scaled like a Win32 WHEEL_DELTA
+            float wheelDelta = (press->detail == XCB_BUTTON_INDEX_4) ? 120.0f : -120.0f;
+            zoom += wheelDelta * 0.005f * zoomSpeed;
+            camera.translate(glm::vec3(0.0f, 0.0f, wheelDelta * 0.005f * zoomSpeed));
+            viewUpdated = true;
+            break;
+        }
+        }
+        break;
+    }
+    case XCB_BUTTON_RELEASE: {
+        const xcb_button_release_event_t* release = (const xcb_button_release_event_t*)event;
+        switch (release->detail) {
+        case XCB_BUTTON_INDEX_1:
+            mouseButtons.left = false;
+            break;
+        case XCB_BUTTON_INDEX_2:
+            mouseButtons.middle = false;
+            break;
+        case XCB_BUTTON_INDEX_3:
+            mouseButtons.right = false;
+            break;
+        }
+        break;
+    }
+    case XCB_KEY_PRESS: {
+        const xcb_key_press_event_t* keyEvent = (const xcb_key_press_event_t*)event;
+        switch (keyEvent->detail) {
+        case KEY_P:
+            paused = !paused;
+            break;
+        case KEY_F1:
+            if (settings.overlay) {
+                UIOverlay.visible = !UIOverlay.visible;
+            }
+            break;
+        case KEY_ESCAPE:
+            quit = true;
+            break;
+        }
+        if (camera.firstperson) {
+            switch (keyEvent->detail) {
+            case KEY_W:
+                camera.keys.up = true;
+                break;
+            case KEY_S:
+                camera.keys.down = true;
+                break;
+            case KEY_A:
+                camera.keys.left = true;
+                break;
+            case KEY_D:
+                camera.keys.right = true;
+                break;
+            }
+        }
+        keyPressed(keyEvent->detail);
+        break;
+    }
+    case XCB_KEY_RELEASE: {
+        const xcb_key_release_event_t* keyEvent = (const xcb_key_release_event_t*)event;
+        if (camera.firstperson) {
+            switch (keyEvent->detail) {
+            case KEY_W:
+                camera.keys.up = false;
+                break;
+            case KEY_S:
+                camera.keys.down = false;
+                break;
+            case KEY_A:
+                camera.keys.left = false;
+                break;
+            case KEY_D:
+                camera.keys.right = false;
+                break;
+            }
+        }
+        break;
+    }
+    case XCB_DESTROY_NOTIFY:
+        quit = true;
+        break;
+    case XCB_CONFIGURE_NOTIFY: {
+        const xcb_configure_notify_event_t* cfgEvent = (const xcb_configure_notify_event_t*)event;
+        if ((prepared) && ((cfgEvent->width != destWidth) || (cfgEvent->height != destHeight))) {
+            destWidth = cfgEvent->width;
+            destHeight = cfgEvent->height;
+            if ((destWidth > 0) && (destHeight > 0)) {
+                requestResize();
+            }
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
 #elif (defined(VK_USE_PLATFORM_IOS_MVK) || defined(VK_USE_PLATFORM_MACOS_MVK))
 void* VulkanFramework::setupWindow(void* view)
 {
@@ -1290,48 +1750,165 @@ void VulkanFramework::windowResize()
     if (!prepared) return;
 
     prepared = false;
+    recreateSwapChain(destWidth, destHeight);
+    applyResize();
+    prepared = true;
+}
 
-    // Ensure all operations on the device have been finished before destroying resources
-    vkDeviceWaitIdle(device);
-
-    // Recreate swap chain
-    width = destWidth;
-    height = destHeight;
+void VulkanFramework::recreateSwapChain(uint32_t newWidth, uint32_t newHeight)
+{
+    swapChainSuboptimal = false;
+
+    // Frames in flight still render to the old swap chain, so instead of waiting for the device to go idle everything
+    // they use is retired and destroyed once the GPU is done with it
+    RetiredSwapChain retired;
+    retired.frameBuffers = frameBuffers;
+    const uint32_t lastWidth = width;
+    const uint32_t lastHeight = height;
+    const uint32_t lastImageCount = swapChain.imageCount;
+
+    // Recreate swap chain, the old one is passed as oldSwapchain and retired
+    width = newWidth;
+    height = newHeight;
     setupSwapChain();
-
-    // Recreate the frame buffers
-    vkDestroyImageView(device, depthStencil.view, nullptr);
-    vkDestroyImage(device, depthStencil.image, nullptr);
-    vkFreeMemory(device, depthStencil.mem, nullptr);
-    setupDepthStencil();
-    for (uint32_t i = 0; i < frameBuffers.size(); i++) {
-        vkDestroyFramebuffer(device, frameBuffers[i], nullptr);
+    retired.swapChain = swapChain.retiredSwapChain;
+    retired.views.swap(swapChain.retiredViews);
+    swapChain.retiredSwapChain = VK_NULL_HANDLE;
+
+    // Only size dependent resources are recreated, rotations and suboptimal swap chains often keep the size
+    if ((width != lastWidth) || (height != lastHeight)) {
+        retired.depthImage = depthStencil.image;
+        retired.depthView = depthStencil.view;
+        retired.depthMemory = depthStencil.mem;
+        setupDepthStencil();
     }
     setupFrameBuffer();
 
-    if ((width > 0.0f) && (height > 0.0f)) {
-        if (settings.overlay) {
-            UIOverlay.resize(width, height);
-        }
+    if (settings.timelineSemaphores) {
+        retired.frameValue = timelines.frame.submitted();
+    } else {
+        // A submission without batches signals its fence once all work submitted before it has completed
+        VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo(0);
+        VK_CHECK(vkCreateFence(device, &fenceCreateInfo, nullptr, &retired.fence));
+        VK_CHECK(vkQueueSubmit(queue, 0, nullptr, retired.fence));
     }
+    retiredSwapChains.push_back(retired);
 
-    // Command buffers need to be recreated as they may store
-    // references to the recreated frame buffer
-    destroyCommandBuffers();
-    createCommandBuffers();
+    // Command buffers may store references to the recreated frame buffers and are recorded again before their next use
+    // Their fences make sure that none of them is still executing by then
+    if (swapChain.imageCount != lastImageCount) {
+        // Command buffers and fences are per swap chain image, a different image count is rare enough to wait for
+        vkDeviceWaitIdle(device);
+        destroyCommandBuffers();
+        for (auto& fence : waitFences) {
+            vkDestroyFence(device, fence, nullptr);
+        }
+        createCommandBuffers();
+        createSynchronizationPrimitives();
+    }
     invalidateCommandBuffers();
 
-    vkDeviceWaitIdle(device);
+    // Notify derived class
+    windowResized();
+}
 
+void VulkanFramework::applyResize()
+{
     if ((width > 0.0f) && (height > 0.0f)) {
+        if (settings.overlay) {
+            UIOverlay.resize(width, height);
+        }
         camera.updateAspectRatio((float)width / (float)height);
     }
-
-    // Notify derived class
-    windowResized();
     viewChanged();
+}
 
-    prepared = true;
+void VulkanFramework::resizeSwapChain()
+{
+    if (!settings.renderThread) {
+        windowResize();
+        return;
+    }
+    // Render thread, the main thread picks up the new size at the next published frame
+    uint32_t newWidth = width;
+    uint32_t newHeight = height;
+    {
+        std::lock_guard<std::mutex> lock(renderMutex);
+        if (resizePending) {
+            resizePending = false;
+            newWidth = resizeWidth;
+            newHeight = resizeHeight;
+        }
+    }
+    recreateSwapChain(newWidth, newHeight);
+    std::lock_guard<std::mutex> lock(renderMutex);
+    swapChainResized = true;
+}
+
+void VulkanFramework::destroyRetiredSwapChains(bool wait)
+{
+    // Retired in submission order, so their fences signal in that order too
+    while (!retiredSwapChains.empty()) {
+        RetiredSwapChain& retired = retiredSwapChains.front();
+        if (settings.timelineSemaphores) {
+            if (wait) {
+                timelines.frame.wait(retired.frameValue);
+            } else if (!timelines.frame.reached(retired.frameValue)) {
+                break;
+            }
+        } else if (wait) {
+            VK_CHECK(vkWaitForFences(device, 1, &retired.fence, VK_TRUE, UINT64_MAX));
+        } else if (vkGetFenceStatus(device, retired.fence) != VK_SUCCESS) {
+            break;
+        }
+        for (VkFramebuffer frameBuffer : retired.frameBuffers) {
+            vkDestroyFramebuffer(device, frameBuffer, nullptr);
+        }
+        for (VkImageView view : retired.views) {
+            vkDestroyImageView(device, view, nullptr);
+        }
+        if (retired.depthImage != VK_NULL_HANDLE) {
+            vkDestroyImageView(device, retired.depthView, nullptr);
+            vkDestroyImage(device, retired.depthImage, nullptr);
+            vkFreeMemory(device, retired.depthMemory, nullptr);
+        }
+        vkDestroySwapchainKHR(device, retired.swapChain, nullptr);
+        vkDestroyFence(device, retired.fence, nullptr);
+        retiredSwapChains.erase(retiredSwapChains.begin());
+    }
+}
+
+bool VulkanFramework::enableTimelineSemaphores()
+{
+    if ((apiVersion < VK_API_VERSION_1_2) || (deviceProperties.apiVersion < VK_API_VERSION_1_2)) {
+        return false;
+    }
+    VkPhysicalDeviceTimelineSemaphoreFeatures supportedFeatures = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES };
+    VkPhysicalDeviceFeatures2 features2 = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2 };
+    features2.pNext = &supportedFeatures;
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+    if (!supportedFeatures.timelineSemaphore) {
+        return false;
+    }
+    // Goes in front of whatever the derived class chained in getEnabledFeatures()
+    timelineSemaphoreFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+    timelineSemaphoreFeatures.timelineSemaphore = VK_TRUE;
+    timelineSemaphoreFeatures.pNext = deviceCreatepNextChain;
+    deviceCreatepNextChain = &timelineSemaphoreFeatures;
+    return true;
+}
+
+void VulkanFramework::requestResize()
+{
+    // The swapchain belongs to the render thread while it runs, it takes the size at the next frame handshake
+    if (renderThread.joinable()) {
+        std::lock_guard<std::mutex> lock(renderMutex);
+        resizePending = true;
+        resizeWidth = destWidth;
+        resizeHeight = destHeight;
+    } else {
+        windowResize();
+    }
 }
 
 void VulkanFramework::handleMouseMove(int32_t x, int32_t y)
@@ -1378,6 +1955,8 @@ void VulkanFramework::initSwapchain()
     swapChain.initialize(windowInstance, window, instance, physicalDevice, device);
 #elif defined(VK_USE_PLATFORM_ANDROID_KHR)
     swapChain.initialize(androidApp->window, instance, physicalDevice, device);
+#elif defined(VK_USE_PLATFORM_XCB_KHR)
+    swapChain.initialize(connection, window, instance, physicalDevice, device);
 #elif (defined(VK_USE_PLATFORM_IOS_MVK) || defined(VK_USE_PLATFORM_MACOS_MVK))
     swapChain.initialize(view, instance, physicalDevice, device);
 #endif
@@ -1385,5 +1964,15 @@ void VulkanFramework::initSwapchain()
 
 void VulkanFramework::setupSwapChain()
 {
-    swapChain.create(&width, &height, settings.vsync);
+    const VkPresentModeKHR lastPresentMode = swapChain.presentMode;
+    const uint32_t lastImageCount = swapChain.imageCount;
+    swapChain.create(&width, &height, settings.vsync, settings.presentMode, settings.swapImages);
+    // Resizes usually recreate the same configuration, only report changes
+    if ((swapChain.presentMode != lastPresentMode) || (swapChain.imageCount != lastImageCount)) {
+#if defined(VK_USE_PLATFORM_ANDROID_KHR)
+        LOGD("Present mode %s with %d swapchain images", vks::tools::presentModeString(swapChain.presentMode).c_str(), swapChain.imageCount);
+#else
+        std::cout << "Present mode " << vks::tools::presentModeString(swapChain.presentMode) << " with " << swapChain.imageCount << " swapchain images" << std::endl;
+#endif
+    }
 }
\ No newline at end of file
@@ -20,10 +20,15 @@
 #include <android_native_app_glue.h>
 #include <sys/system_properties.h>
 #include "VulkanAndroid.h"
+#elif defined(VK_USE_PLATFORM_XCB_KHR)
+#include <xcb/xcb.h>
 #endif
 
 #include <iostream>
 #include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 #include <sys/stat.h>
 
 #define GLM_FORCE_RADIANS
@@ -45,6 +50,7 @@
 #include "VulkanInitializers.hpp"
 #include "VulkanDevice.hpp"
 #include "VulkanSwapChain.hpp"
+#include "FramePacer.hpp"
 #include "camera.hpp"
 
 class VulkanFramework
@@ -58,9 +64,52 @@ private:
 	uint32_t destWidth;
 	uint32_t destHeight;
 	bool resizing = false;
+	// The last image was acquired from a suboptimal swap chain, it's recreated once that image has been presented
+	bool swapChainSuboptimal = false;
 	// Called if the window is resized and some resources have to be recreatesd
 	void windowResize();
+	// Resizes right away, or on the next render thread frame if one is running
+	void requestResize();
+	// Swap chain and size dependent resources, on the render thread if one is running
+	void recreateSwapChain(uint32_t newWidth, uint32_t newHeight);
+	// Camera and overlay, always on the main thread
+	void applyResize();
+	// Out of date or suboptimal swap chain, recreated with the pending size or the current one
+	void resizeSwapChain();
 	void handleMouseMove(int32_t x, int32_t y);
+	// Resources replaced by a resize, destroyed once the fence submitted behind the last frame using them has signaled
+	struct RetiredSwapChain {
+		// Frame timeline value with settings.timelineSemaphores, else the fence
+		VkFence fence = VK_NULL_HANDLE;
+		uint64_t frameValue = 0;
+		VkSwapchainKHR swapChain;
+		std::vector<VkImageView> views;
+		std::vector<VkFramebuffer> frameBuffers;
+		VkImage depthImage = VK_NULL_HANDLE;
+		VkImageView depthView = VK_NULL_HANDLE;
+		VkDeviceMemory depthMemory = VK_NULL_HANDLE;
+	};
+	std::vector<RetiredSwapChain> retiredSwapChains;
+	// Destroys the retired resources the GPU is done with, or waits for all of them
+	void destroyRetiredSwapChains(bool wait);
+	// Enables timeline semaphores for device creation if the device supports them
+	VkPhysicalDeviceTimelineSemaphoreFeatures timelineSemaphoreFeatures{};
+	bool enableTimelineSemaphores();
+	// Render thread, see settings.renderThread
+	std::thread renderThread;
+	std::mutex renderMutex;
+	std::condition_variable renderCondition;
+	// Render thread is blocked until the main thread publishes the next frame
+	bool renderParked = false;
+	bool framePublished = false;
+	bool renderStop = false;
+	// Size requested by the main thread, and whether the render thread recreated the swap chain since the last published frame
+	bool resizePending = false;
+	uint32_t resizeWidth = 0;
+	uint32_t resizeHeight = 0;
+	bool swapChainResized = false;
+	void renderThreadLoop();
+	void stopRenderThread();
 protected:
 	// Frame counter to display fps
 	uint32_t frameCounter = 0;
@@ -87,6 +136,10 @@ protected:
 	VkDevice device;
 	// Handle to the device graphics queue that command buffers are submitted to
 	VkQueue queue;
+	// Handle to the queue of the transfer family, a dedicated one if the device has it and else the graphics queue
+	VkQueue transferQueue;
+	// Handle to the queue of the compute family, a dedicated one if the device has it and else the graphics queue
+	VkQueue computeQueue;
 	// Depth buffer format (selected during Vulkan initialization)
 	VkFormat depthFormat;
 	// Command buffer pool
@@ -98,6 +151,8 @@ protected:
 	// Command buffers used for rendering
 	std::vector<VkCommandBuffer> drawCmdBuffers;
     std::vector<bool> drawCmdBuffersValid;
+    // Frame timeline value signaled by the last submission of each command buffer
+    std::vector<uint64_t> drawCmdBufferValues;
 
 	// Global render pass for frame buffer writes
 	VkRenderPass renderPass;
@@ -121,6 +176,12 @@ protected:
 		VkSemaphore renderComplete;
 	} semaphores;
 	std::vector<VkFence> waitFences;
+	/** @brief Completion timelines of the graphics, transfer and compute queue, only created with settings.timelineSemaphores */
+	struct {
+		vks::TimelineSemaphore frame;
+		vks::TimelineSemaphore transfer;
+		vks::TimelineSemaphore compute;
+	} timelines;
 
 
 public: 
@@ -146,10 +207,21 @@ public:
 		bool fullscreen = false;
 		/** @brief Set to true if v-sync will be forced for the swapchain */
 		bool vsync = false;
+		/** @brief Present mode requested via command line, VK_PRESENT_MODE_MAX_ENUM_KHR lets the swapchain pick one */
+		VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAX_ENUM_KHR;
+		/** @brief Number of swapchain images requested via command line, 0 uses the swapchain default */
+		uint32_t swapImages = 0;
+		/** @brief Acquire, record, submit and present on a separate thread while the main thread handles input and simulation */
+		bool renderThread = false;
+		/** @brief Track frame and upload completion with Vulkan 1.2 timeline semaphores instead of fences, cleared if unsupported */
+		bool timelineSemaphores = false;
 		/** @brief Enable UI overlay */
 		bool overlay = false;
 	} settings;
 
+	/** @brief Frame rate limiter and low-latency pacing, configured via -fps and -lowlatency */
+	vks::FramePacer framePacer;
+
 	VkClearColorValue defaultClearColor = { { 0.0f, 0.0f, 0.0f, 1.0f } };
 
 	float zoom = 0;
@@ -212,6 +284,12 @@ public:
 	int64_t lastTapTime = 0;
 	/** @brief Product model and manufacturer of the Android device (via android.Product*) */
 	std::string androidProduct;
+#elif defined(VK_USE_PLATFORM_XCB_KHR)
+	bool quit = false;
+	xcb_connection_t* connection = nullptr;
+	xcb_screen_t* screen;
+	xcb_window_t window = XCB_NONE;
+	xcb_intern_atom_reply_t* atom_wm_delete_window = nullptr;
 #elif (defined(VK_USE_PLATFORM_IOS_MVK) || defined(VK_USE_PLATFORM_MACOS_MVK))
 	void* view;
 #endif
@@ -233,6 +311,10 @@ public:
 #elif defined(VK_USE_PLATFORM_ANDROID_KHR)
 	static int32_t handleAppInput(struct android_app* app, AInputEvent* event);
 	static void handleAppCommand(android_app* app, int32_t cmd);
+#elif defined(VK_USE_PLATFORM_XCB_KHR)
+	void initxcbConnection();
+	xcb_window_t setupWindow();
+	void handleEvent(const xcb_generic_event_t* event);
 #elif (defined(VK_USE_PLATFORM_IOS_MVK) || defined(VK_USE_PLATFORM_MACOS_MVK))
 	void* setupWindow(void* view);
 #endif
@@ -256,11 +338,24 @@ public:
     virtual void mouseMoved(double x, double y, bool &handled) {}
 	// Called when the window has been resized
 	// Can be overriden in derived class to recreate or rebuild resources attached to the frame buffer / swapchain
+	// Runs on the render thread with settings.renderThread, viewChanged() follows on the main thread
     virtual void windowResized() {}
 	
     // Build command buffer for current frame index, if drawCmdBuffersValid[currentIndex] is false
     virtual void buildCommandBuffer(VkCommandBuffer drawCmdBuffer, VkFramebuffer frameBuffer) = 0;
     void invalidateCommandBuffers();
+    /** @brief Waits until the last submission of drawCmdBuffers[index] has completed, so it can be recorded and submitted again */
+    void waitForDrawCmdBuffer(uint32_t index);
+    /** @brief Submits drawCmdBuffers[currentBuffer] with submitInfo, returns the frame timeline value it signals (0 without timelines) */
+    uint64_t submitDrawCmdBuffer();
+
+    // With settings.renderThread, render() only advances the simulation and the frame is split between the threads:
+    /** @brief (Virtual) Render thread: waits until the next frame can be recorded (image acquire, fences) */
+    virtual void beginThreadedFrame() {}
+    /** @brief (Virtual) Main thread while the render thread is blocked: hands the state of the frame over to the render thread */
+    virtual void publishThreadedFrame() {}
+    /** @brief (Virtual) Render thread: records, submits and presents the published frame */
+    virtual void endThreadedFrame() {}
 
 	void createSynchronizationPrimitives();
 
@@ -39,9 +39,14 @@ public:
     VkColorSpaceKHR colorSpace;
     /** @brief Handle to the current swap chain, required for recreation */
     VkSwapchainKHR swapChain = VK_NULL_HANDLE;
-    uint32_t imageCount;
+    uint32_t imageCount = 0;
+    /** @brief Present mode the current swap chain was created with */
+    VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAX_ENUM_KHR;
     std::vector<VkImage> images;
     std::vector<SwapChainBuffer> buffers;
+    /** @brief Swap chain and image views replaced by the last create(), the caller destroys them once the GPU is done with them */
+    VkSwapchainKHR retiredSwapChain = VK_NULL_HANDLE;
+    std::vector<VkImageView> retiredViews;
     /** @brief Queue family index of the detected graphics and presenting device queue */
     uint32_t queueNodeIndex = UINT32_MAX;
 
@@ -50,6 +55,8 @@ public:
     void initialize(void* platformHandle, void* platformWindow, VkInstance instance_, VkPhysicalDevice physicalDevice_, VkDevice device_)
 #elif defined(VK_USE_PLATFORM_ANDROID_KHR)
     void initialize(ANativeWindow* window, VkInstance instance_, VkPhysicalDevice physicalDevice_, VkDevice device_)
+#elif defined(VK_USE_PLATFORM_XCB_KHR)
+    void initialize(xcb_connection_t* connection, xcb_window_t window, VkInstance instance_, VkPhysicalDevice physicalDevice_, VkDevice device_)
 #elif (defined(VK_USE_PLATFORM_IOS_MVK) || defined(VK_USE_PLATFORM_MACOS_MVK))
     void initialize(void* view, VkInstance instance_, VkPhysicalDevice physicalDevice_, VkDevice device_)
 #endif
@@ -70,6 +77,11 @@ public:
         VkAndroidSurfaceCreateInfoKHR surfaceCreateInfo = { VK_STRUCTURE_TYPE_ANDROID_SURFACE_CREATE_INFO_KHR };
         surfaceCreateInfo.window = window;
         err = vkCreateAndroidSurfaceKHR(instance, &surfaceCreateInfo, NULL, &surface);
+#elif defined(VK_USE_PLATFORM_XCB_KHR)
+        VkXcbSurfaceCreateInfoKHR surfaceCreateInfo = { VK_STRUCTURE_TYPE_XCB_SURFACE_CREATE_INFO_KHR };
+        surfaceCreateInfo.connection = connection;
+        surfaceCreateInfo.window = window;
+        err = vkCreateXcbSurfaceKHR(instance, &surfaceCreateInfo, nullptr, &surface);
 #elif defined(VK_USE_PLATFORM_IOS_MVK)
         VkIOSSurfaceCreateInfoMVK surfaceCreateInfo = { VK_STRUCTURE_TYPE_IOS_SURFACE_CREATE_INFO_MVK };
         surfaceCreateInfo.flags = 0;
@@ -183,8 +195,10 @@ public:
     * @param width Pointer to the width of the swapchain (may be adjusted to fit the requirements of the swapchain)
     * @param height Pointer to the height of the swapchain (may be adjusted to fit the requirements of the swapchain)
     * @param vsync (Optional) Can be used to force vsync'd rendering (by using VK_PRESENT_MODE_FIFO_KHR as presentation mode)
+    * @param requestedPresentMode (Optional) Present mode to use if the surface supports it, VK_PRESENT_MODE_MAX_ENUM_KHR selects one automatically
+    * @param requestedImageCount (Optional) Number of swap chain images, clamped to the surface limits, 0 uses one more than the minimum
     */
-    void create(uint32_t* width, uint32_t* height, bool vsync = false)
+    void create(uint32_t* width, uint32_t* height, bool vsync = false, VkPresentModeKHR requestedPresentMode = VK_PRESENT_MODE_MAX_ENUM_KHR, uint32_t requestedImageCount = 0)
     {
         VkSwapchainKHR oldSwapchain = swapChain;
 
@@ -234,8 +248,24 @@ public:
             }
         }
 
+        // An explicitly requested mode overrides the automatic selection if the surface supports it
+        if (requestedPresentMode != VK_PRESENT_MODE_MAX_ENUM_KHR) {
+            if (std::find(presentModes.begin(), presentModes.end(), requestedPresentMode) != presentModes.end()) {
+                swapchainPresentMode = requestedPresentMode;
+            } else if (presentMode == VK_PRESENT_MODE_MAX_ENUM_KHR) {
+#if defined(VK_USE_PLATFORM_ANDROID_KHR)
+                LOGW("Present mode %s is not supported by the surface, using %s", vks::tools::presentModeString(requestedPresentMode).c_str(),
+                    vks::tools::presentModeString(swapchainPresentMode).c_str());
+#else
+                std::cerr << "Present mode " << vks::tools::presentModeString(requestedPresentMode) << " is not supported by the surface, using "
+                    << vks::tools::presentModeString(swapchainPresentMode) << std::endl;
+#endif
+            }
+        }
+        presentMode = swapchainPresentMode;
+
         // Determine the number of images
-        uint32_t desiredNumberOfSwapchainImages = surfCaps.minImageCount + 1;
+        uint32_t desiredNumberOfSwapchainImages = (requestedImageCount > 0) ? std::max(requestedImageCount, surfCaps.minImageCount) : surfCaps.minImageCount + 1;
         if ((surfCaps.maxImageCount > 0) && (desiredNumberOfSwapchainImages > surfCaps.maxImageCount)) {
             desiredNumberOfSwapchainImages = surfCaps.maxImageCount;
         }
@@ -295,13 +325,14 @@ public:
 
         VK_CHECK(vkCreateSwapchainKHR(device, &swapchainCI, nullptr, &swapChain));
 
-        // If an existing swap chain is re-created, destroy the old swap chain
-        // This also cleans up all the presentable images
+        // If an existing swap chain is re-created, the old swap chain is retired instead of destroyed
+        // Frames still in flight may render to its images, see retiredSwapChain
         if (oldSwapchain != VK_NULL_HANDLE) {
+            destroyRetired();
             for (uint32_t i = 0; i < imageCount; i++) {
-                vkDestroyImageView(device, buffers[i].view, nullptr);
+                retiredViews.push_back(buffers[i].view);
             }
-            vkDestroySwapchainKHR(device, oldSwapchain, nullptr);
+            retiredSwapChain = oldSwapchain;
         }
         VK_CHECK(vkGetSwapchainImagesKHR(device, swapChain, &imageCount, NULL));
 
@@ -376,11 +407,25 @@ public:
         return vkQueuePresentKHR(queue, &presentInfo);
     }
 
+    /** @brief Destroys the swap chain retired by the last create(), only call once no frame uses it any more */
+    void destroyRetired()
+    {
+        for (VkImageView view : retiredViews) {
+            vkDestroyImageView(device, view, nullptr);
+        }
+        retiredViews.clear();
+        if (retiredSwapChain != VK_NULL_HANDLE) {
+            vkDestroySwapchainKHR(device, retiredSwapChain, nullptr);
+            retiredSwapChain = VK_NULL_HANDLE;
+        }
+    }
+
     /**
     * Destroy and free Vulkan resources used for the swapchain
     */
     void cleanup()
     {
+        destroyRetired();
         if (swapChain != VK_NULL_HANDLE) {
             for (uint32_t i = 0; i < imageCount; i++) {
                 vkDestroyImageView(device, buffers[i].view, nullptr);
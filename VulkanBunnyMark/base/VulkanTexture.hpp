@@ -28,13 +28,66 @@
 
 namespace vks
 {
+	/**
+	* Records the uploads of many textures into one command buffer
+	*
+	* Staging buffers are suballocated by VMA and kept until submit(), which executes all copies and layout
+	* transitions with a single queue submission and wait instead of one per texture.
+	*/
+	class TextureUploadBatch {
+	public:
+		TextureUploadBatch(vks::VulkanDevice *vdevice, VkQueue copyQueue) : device(vdevice), queue(copyQueue) {}
+		~TextureUploadBatch() { submit(); }
+
+		TextureUploadBatch(const TextureUploadBatch&) = delete;
+		TextureUploadBatch& operator=(const TextureUploadBatch&) = delete;
+
+		/** @brief Command buffer the uploads are recorded to, allocated and begun on first use */
+		VkCommandBuffer commandBuffer()
+		{
+			if (copyCmd == VK_NULL_HANDLE) {
+				copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+			}
+			return copyCmd;
+		}
+
+		/** @brief Copies data to a new staging buffer that lives until the batch has been submitted */
+		VkBuffer stage(const void* data, VkDeviceSize size)
+		{
+			stagingBuffers.push_back(vks::Buffer());
+			vks::Buffer& staging = stagingBuffers.back();
+			staging.create(device, vks::BufferType::staging, 0, size, true);
+			memcpy(staging.mappedData, data, (size_t)size);
+			return staging.buffer;
+		}
+
+		/** @brief Executes all recorded uploads, waits for them to finish and releases the staging buffers */
+		void submit()
+		{
+			if (copyCmd != VK_NULL_HANDLE) {
+				device->flushCommandBuffer(copyCmd, queue);
+				copyCmd = VK_NULL_HANDLE;
+			}
+			for (auto& staging : stagingBuffers) {
+				staging.destroy();
+			}
+			stagingBuffers.clear();
+		}
+
+	private:
+		vks::VulkanDevice *device;
+		VkQueue queue;
+		VkCommandBuffer copyCmd = VK_NULL_HANDLE;
+		std::vector<vks::Buffer> stagingBuffers;
+	};
+
 	/** @brief Vulkan texture base class */
 	class Texture {
 	public:
 		vks::VulkanDevice *device;
 		VkImage image;
 		VkImageLayout imageLayout;
-		VkDeviceMemory deviceMemory;
+		VmaAllocation allocation;
 		VkImageView view;
 		uint32_t width, height;
 		uint32_t mipLevels;
@@ -50,11 +103,214 @@ namespace vks
 
 		void destroy() {
 			vkDestroyImageView(*device, view, nullptr);
-			vkDestroyImage(*device, image, nullptr);
 			if (sampler) {
 				vkDestroySampler(*device, sampler, nullptr);
 			}
-			vkFreeMemory(*device, deviceMemory, nullptr);
+			vmaDestroyImage(device->allocator, image, allocation);
+		}
+
+		/** @brief Number of levels of a full mip chain down to 1x1 */
+		static uint32_t mipLevelCount(uint32_t texWidth, uint32_t texHeight)
+		{
+			uint32_t levels = 1;
+			for (uint32_t size = std::max(texWidth, texHeight); size > 1; size >>= 1) {
+				levels++;
+			}
+			return levels;
+		}
+
+		/**
+		* Builds the mip chain of an RGBA8 image on the CPU
+		*
+		* Each level is a 2x2 box filter of the previous one, colors are weighted by alpha so transparent texels don't darken sprite edges
+		* @return Level 0 followed by the smaller levels, tightly packed
+		*/
+		static std::vector<uint8_t> buildMipChain(const uint8_t* pixels, uint32_t texWidth, uint32_t texHeight, uint32_t texMipLevels)
+		{
+			std::vector<uint8_t> chain(pixels, pixels + (size_t)texWidth * texHeight * 4);
+			size_t levelOffset = 0;
+			for (uint32_t level = 1; level < texMipLevels; level++) {
+				const uint32_t srcWidth = std::max(1u, texWidth >> (level - 1)), srcHeight = std::max(1u, texHeight >> (level - 1));
+				const uint32_t dstWidth = std::max(1u, texWidth >> level), dstHeight = std::max(1u, texHeight >> level);
+				const size_t dstOffset = chain.size();
+				chain.resize(dstOffset + (size_t)dstWidth * dstHeight * 4);
+				const uint8_t* src = chain.data() + levelOffset;
+				uint8_t* dst = chain.data() + dstOffset;
+				for (uint32_t y = 0; y < dstHeight; y++) {
+					for (uint32_t x = 0; x < dstWidth; x++) {
+						const uint32_t x0 = std::min(2 * x, srcWidth - 1), x1 = std::min(2 * x + 1, srcWidth - 1);
+						const uint32_t y0 = std::min(2 * y, srcHeight - 1), y1 = std::min(2 * y + 1, srcHeight - 1);
+						const uint8_t* texels[4] = {
+							src + ((size_t)y0 * srcWidth + x0) * 4,
+							src + ((size_t)y0 * srcWidth + x1) * 4,
+							src + ((size_t)y1 * srcWidth + x0) * 4,
+							src + ((size_t)y1 * srcWidth + x1) * 4
+						};
+						const uint32_t alpha = texels[0][3] + texels[1][3] + texels[2][3] + texels[3][3];
+						uint8_t* texel = dst + ((size_t)y * dstWidth + x) * 4;
+						for (uint32_t c = 0; c < 3; c++) {
+							uint32_t sum = 0;
+							for (uint32_t t = 0; t < 4; t++) {
+								sum += alpha ? texels[t][c] * texels[t][3] : texels[t][c];
+							}
+							const uint32_t weight = alpha ? alpha : 4;
+							texel[c] = (uint8_t)((sum + weight / 2) / weight);
+						}
+						texel[3] = (uint8_t)((alpha + 2) / 4);
+					}
+				}
+				levelOffset = dstOffset;
+			}
+			return chain;
+		}
+
+		/**
+		* Creates the image, view and sampler of the texture from texel data of any format, including block compressed ones
+		*
+		* @param buffer Texel data of all layers and mip levels, copied to a staging buffer as is
+		* @param bufferSize Size of the buffer in machine units
+		* @param format Vulkan format of the image data stored in the buffer
+		* @param texWidth Width of the texture to create
+		* @param texHeight Height of the texture to create
+		* @param texLayerCount Number of array layers
+		* @param texMipLevels Number of mip levels of every layer
+		* @param bufferCopyRegions Copy regions with offsets into the buffer, one per layer and mip level
+		* @param viewType Image view type, 2D textures with a single layer or arrays
+		* @param device Vulkan device to create the texture on
+		* @param copyQueue Queue used for the texture staging copy commands (must support transfer)
+		* @param batch (Optional) Batch that records the upload, the texture may only be used once the batch has been submitted. Uploads immediately if nullptr
+		*/
+		void fromRegions(
+			const void* buffer,
+			VkDeviceSize bufferSize,
+			VkFormat format,
+			uint32_t texWidth,
+			uint32_t texHeight,
+			uint32_t texLayerCount,
+			uint32_t texMipLevels,
+			const std::vector<VkBufferImageCopy>& bufferCopyRegions,
+			VkImageViewType viewType,
+			vks::VulkanDevice *vdevice,
+			VkQueue copyQueue,
+			TextureUploadBatch* batch = nullptr)
+		{
+			assert(buffer);
+			assert(texLayerCount > 0 && texMipLevels > 0);
+
+			createImage(format, texWidth, texHeight, texLayerCount, texMipLevels, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, vdevice);
+
+			TextureUploadBatch immediate(device, copyQueue);
+			TextureUploadBatch& upload = batch ? *batch : immediate;
+			VkBuffer stagingBuffer = upload.stage(buffer, bufferSize);
+			VkCommandBuffer copyCmd = upload.commandBuffer();
+
+			VkImageSubresourceRange subresourceRange = {};
+			subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			subresourceRange.baseMipLevel = 0;
+			subresourceRange.levelCount = mipLevels;
+			subresourceRange.layerCount = layerCount;
+
+			vks::tools::setImageLayout(
+				copyCmd,
+				image,
+				VK_IMAGE_LAYOUT_UNDEFINED,
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				subresourceRange);
+
+			vkCmdCopyBufferToImage(
+				copyCmd,
+				stagingBuffer,
+				image,
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				static_cast<uint32_t>(bufferCopyRegions.size()),
+				bufferCopyRegions.data());
+
+			// Change texture image layout to shader read after all mip levels have been copied
+			vks::tools::setImageLayout(
+				copyCmd,
+				image,
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				imageLayout,
+				subresourceRange);
+
+			if (!batch) {
+				immediate.submit();
+			}
+
+			createView(format, viewType);
+		}
+
+		/**
+		* Creates the image of the texture, suballocated from the allocator's device local blocks instead of one allocation per texture
+		*
+		* @param usage Image usage flags
+		* @param queueFamilies (Optional) Queue families that access the image concurrently, exclusive to one family if empty
+		* @note Leaves the image in VK_IMAGE_LAYOUT_UNDEFINED, the layout it is sampled in is set to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+		*/
+		void createImage(
+			VkFormat format,
+			uint32_t texWidth,
+			uint32_t texHeight,
+			uint32_t texLayerCount,
+			uint32_t texMipLevels,
+			VkImageUsageFlags usage,
+			vks::VulkanDevice *vdevice,
+			const std::vector<uint32_t>& queueFamilies = std::vector<uint32_t>())
+		{
+			device = vdevice;
+			width = texWidth;
+			height = texHeight;
+			layerCount = texLayerCount;
+			mipLevels = texMipLevels;
+			imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+			VkImageCreateInfo imageCreateInfo = { VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+			imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+			imageCreateInfo.format = format;
+			imageCreateInfo.mipLevels = mipLevels;
+			imageCreateInfo.arrayLayers = layerCount;
+			imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			if (queueFamilies.size() > 1) {
+				imageCreateInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+				imageCreateInfo.queueFamilyIndexCount = static_cast<uint32_t>(queueFamilies.size());
+				imageCreateInfo.pQueueFamilyIndices = queueFamilies.data();
+			}
+			imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			imageCreateInfo.extent = { width, height, 1 };
+			imageCreateInfo.usage = usage;
+			VmaAllocationCreateInfo allocCreateInfo = {};
+			allocCreateInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+			VK_CHECK(vmaCreateImage(device->allocator, &imageCreateInfo, &allocCreateInfo, &image, &allocation, nullptr));
+		}
+
+		/** @brief Creates a linear filtering sampler and a view covering all layers and mip levels of the image */
+		void createView(VkFormat format, VkImageViewType viewType)
+		{
+			VkSamplerCreateInfo samplerCreateInfo = { VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO };
+			samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
+			samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
+			samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+			samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+			samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+			samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+			samplerCreateInfo.mipLodBias = 0.0f;
+			samplerCreateInfo.compareOp = VK_COMPARE_OP_NEVER;
+			samplerCreateInfo.minLod = 0.0f;
+			samplerCreateInfo.maxLod = (float)mipLevels;
+			samplerCreateInfo.maxAnisotropy = 1.0f;
+			VK_CHECK(vkCreateSampler(*device, &samplerCreateInfo, nullptr, &sampler));
+
+			VkImageViewCreateInfo viewCreateInfo = { VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
+			viewCreateInfo.viewType = viewType;
+			viewCreateInfo.format = format;
+			viewCreateInfo.components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A };
+			viewCreateInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, layerCount };
+			viewCreateInfo.image = image;
+			VK_CHECK(vkCreateImageView(*device, &viewCreateInfo, nullptr, &view));
+
+			updateDescriptorInfo();
 		}
 
         stbi_uc* loadImageFile(std::string filename, int* width, int* height) {
@@ -92,17 +348,21 @@ namespace vks
 		* @param format Vulkan format of the image data stored in the file
 		* @param device Vulkan device to create the texture on
 		* @param copyQueue Queue used for the texture staging copy commands (must support transfer)
+		* @param maxMipLevels Number of mip levels to generate (see fromBuffer)
+		* @param batch (Optional) Batch that records the upload, see fromRegions
 		*
 		*/
 		void loadFromFile(
 			std::string filename,
 			vks::VulkanDevice *pdevice,
-			VkQueue copyQueue)
+			VkQueue copyQueue,
+			uint32_t maxMipLevels = 1,
+			TextureUploadBatch* batch = nullptr)
 		{
             int w, h;
             uint8_t* texData = loadImageFile(filename, &w, &h);
             assert(texData);
-            fromBuffer(texData, w * h * 4, VK_FORMAT_R8G8B8A8_UNORM, w, h, pdevice, copyQueue);
+            fromBuffer(texData, w * h * 4, VK_FORMAT_R8G8B8A8_UNORM, w, h, pdevice, copyQueue, maxMipLevels, batch);
             stbi_image_free(texData);
 		}
 
@@ -116,6 +376,9 @@ namespace vks
 		* @param format Vulkan format of the image data stored in the file
 		* @param device Vulkan device to create the texture on
 		* @param copyQueue Queue used for the texture staging copy commands (must support transfer)
+		* @param maxMipLevels Number of mip levels to generate from the buffer contents with buildMipChain, at most the full chain
+		* (RGBA8 formats only, other formats keep a single level)
+		* @param batch (Optional) Batch that records the upload, see fromRegions
 		*/
 		void fromBuffer(
 			void* buffer,
@@ -124,149 +387,102 @@ namespace vks
 			uint32_t texWidth,
 			uint32_t texHeight,
 			vks::VulkanDevice *vdevice,
-			VkQueue copyQueue)
+			VkQueue copyQueue,
+			uint32_t maxMipLevels = 1,
+			TextureUploadBatch* batch = nullptr)
 		{
 			assert(buffer);
 
-			device = vdevice;
-			width = texWidth;
-			height = texHeight;
-			mipLevels = 1;
-
-			VkMemoryAllocateInfo memAllocInfo = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
-			VkMemoryRequirements memReqs;
-
-			// Use a separate command buffer for texture loading
-			VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-
-			// Create a host-visible staging buffer that contains the raw image data
-			VkBuffer stagingBuffer;
-			VkDeviceMemory stagingMemory;
-
-            // This buffer is used as a transfer source for the buffer copy
-			VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, bufferSize);
-			bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-			VK_CHECK(vkCreateBuffer(*device, &bufferCreateInfo, nullptr, &stagingBuffer));
-
-			// Get memory requirements for the staging buffer (alignment, memory type bits)
-			vkGetBufferMemoryRequirements(*device, stagingBuffer, &memReqs);
-
-			memAllocInfo.allocationSize = memReqs.size;
-			// Get memory type index for a host visible buffer
-			memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-			VK_CHECK(vkAllocateMemory(*device, &memAllocInfo, nullptr, &stagingMemory));
-			VK_CHECK(vkBindBufferMemory(*device, stagingBuffer, stagingMemory, 0));
-
-			// Copy texture data into staging buffer
-			uint8_t *data;
-			VK_CHECK(vkMapMemory(*device, stagingMemory, 0, memReqs.size, 0, (void **)&data));
-			memcpy(data, buffer, bufferSize);
-			vkUnmapMemory(*device, stagingMemory);
-
-			VkBufferImageCopy bufferCopyRegion = {};
-			bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			bufferCopyRegion.imageSubresource.mipLevel = 0;
-			bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
-			bufferCopyRegion.imageSubresource.layerCount = 1;
-			bufferCopyRegion.imageExtent.width = width;
-			bufferCopyRegion.imageExtent.height = height;
-			bufferCopyRegion.imageExtent.depth = 1;
-			bufferCopyRegion.bufferOffset = 0;
-
-			// Create optimal tiled target image
-            VkImageCreateInfo imageCreateInfo = { VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
-			imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
-			imageCreateInfo.format = format;
-			imageCreateInfo.mipLevels = mipLevels;
-			imageCreateInfo.arrayLayers = 1;
-			imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-			imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-			imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-			imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-			imageCreateInfo.extent = { width, height, 1 };
-			imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT;
-			// Ensure that the TRANSFER_DST bit is set for staging
-			if (!(imageCreateInfo.usage & VK_IMAGE_USAGE_TRANSFER_DST_BIT)) {
-				imageCreateInfo.usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+			// Not generated with linear blits, those can't weight the colors by alpha
+			uint32_t texMipLevels = 1;
+			std::vector<uint8_t> texels;
+			if (format == VK_FORMAT_R8G8B8A8_UNORM || format == VK_FORMAT_R8G8B8A8_SRGB) {
+				texMipLevels = std::max(1u, std::min(maxMipLevels, mipLevelCount(texWidth, texHeight)));
+			}
+			if (texMipLevels > 1) {
+				texels = buildMipChain((const uint8_t*)buffer, texWidth, texHeight, texMipLevels);
+				buffer = texels.data();
+				bufferSize = texels.size();
 			}
-			VK_CHECK(vkCreateImage(*device, &imageCreateInfo, nullptr, &image));
-
-			vkGetImageMemoryRequirements(*device, image, &memReqs);
-
-			memAllocInfo.allocationSize = memReqs.size;
-			memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-			VK_CHECK(vkAllocateMemory(*device, &memAllocInfo, nullptr, &deviceMemory));
-			VK_CHECK(vkBindImageMemory(*device, image, deviceMemory, 0));
-
-			VkImageSubresourceRange subresourceRange = {};
-			subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			subresourceRange.baseMipLevel = 0;
-			subresourceRange.levelCount = mipLevels;
-			subresourceRange.layerCount = 1;
-
-			// Image barrier for optimal image (target)
-			// Optimal image will be used as destination for the copy
-			vks::tools::setImageLayout(
-				copyCmd,
-				image,
-				VK_IMAGE_LAYOUT_UNDEFINED,
-				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				subresourceRange);
-
-			// Copy mip levels from staging buffer
-			vkCmdCopyBufferToImage(
-				copyCmd,
-				stagingBuffer,
-				image,
-				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				1,
-				&bufferCopyRegion
-			);
-
-			// Change texture image layout to shader read after all mip levels have been copied
-			imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			vks::tools::setImageLayout(
-				copyCmd,
-				image,
-				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				imageLayout,
-				subresourceRange);
-
-			device->flushCommandBuffer(copyCmd, copyQueue);
 
-			// Clean up staging resources
-			vkFreeMemory(*device, stagingMemory, nullptr);
-			vkDestroyBuffer(*device, stagingBuffer, nullptr);
+			std::vector<VkBufferImageCopy> bufferCopyRegions;
+			VkDeviceSize offset = 0;
+			for (uint32_t level = 0; level < texMipLevels; level++) {
+				VkBufferImageCopy region = {};
+				region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				region.imageSubresource.mipLevel = level;
+				region.imageSubresource.baseArrayLayer = 0;
+				region.imageSubresource.layerCount = 1;
+				region.imageExtent.width = std::max(1u, texWidth >> level);
+				region.imageExtent.height = std::max(1u, texHeight >> level);
+				region.imageExtent.depth = 1;
+				region.bufferOffset = offset;
+				bufferCopyRegions.push_back(region);
+				offset += (VkDeviceSize)region.imageExtent.width * region.imageExtent.height * 4;
+			}
+			fromRegions(buffer, bufferSize, format, texWidth, texHeight, 1, texMipLevels, bufferCopyRegions, VK_IMAGE_VIEW_TYPE_2D, vdevice, copyQueue, batch);
+		}
+	};
 
-			// Create sampler
-			VkSamplerCreateInfo samplerCreateInfo = { VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO };
-			samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
-			samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
-			samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-			samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-			samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-			samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-			samplerCreateInfo.mipLodBias = 0.0f;
-			samplerCreateInfo.compareOp = VK_COMPARE_OP_NEVER;
-			samplerCreateInfo.minLod = 0.0f;
-			samplerCreateInfo.maxLod = 0.0f;
-			samplerCreateInfo.maxAnisotropy = 1.0f;
-			VK_CHECK(vkCreateSampler(*device, &samplerCreateInfo, nullptr, &sampler));
+	/** @brief 2D texture array, all layers share the same size and format */
+	class Texture2DArray : public Texture {
+	public:
+		/**
+		* Creates a 2D array texture from a buffer holding all layers back to back, each layer followed by its smaller mip levels
+		*
+		* @param buffer Buffer containing the texture data of all layers to upload
+		* @param bufferSize Size of the buffer in machine units
+		* @param format Vulkan format of the image data stored in the buffer
+		* @param texWidth Width of the texture to create
+		* @param texHeight Height of the texture to create
+		* @param texLayerCount Number of array layers, the buffer holds bufferSize / texLayerCount bytes per layer
+		* @param device Vulkan device to create the texture on
+		* @param copyQueue Queue used for the texture staging copy commands (must support transfer)
+		* @param texMipLevels Number of mip levels stored per layer (uncompressed formats only)
+		* @param batch (Optional) Batch that records the upload, see fromRegions
+		*/
+		void fromBuffer(
+			void* buffer,
+			VkDeviceSize bufferSize,
+			VkFormat format,
+			uint32_t texWidth,
+			uint32_t texHeight,
+			uint32_t texLayerCount,
+			vks::VulkanDevice *vdevice,
+			VkQueue copyQueue,
+			uint32_t texMipLevels = 1,
+			TextureUploadBatch* batch = nullptr)
+		{
+			assert(buffer);
+			assert(texLayerCount > 0);
 
-			// Create image view
-			VkImageViewCreateInfo viewCreateInfo = { VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
-			viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-			viewCreateInfo.format = format;
-			viewCreateInfo.components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A };
-			viewCreateInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-			viewCreateInfo.subresourceRange.levelCount = 1;
-			viewCreateInfo.image = image;
-			VK_CHECK(vkCreateImageView(*device, &viewCreateInfo, nullptr, &view));
+			// One copy region per layer and mip level, the texel size follows from the size of a layer
+			const VkDeviceSize layerSize = bufferSize / texLayerCount;
+			VkDeviceSize layerTexels = 0;
+			for (uint32_t level = 0; level < texMipLevels; level++) {
+				layerTexels += (VkDeviceSize)std::max(1u, texWidth >> level) * std::max(1u, texHeight >> level);
+			}
+			const VkDeviceSize texelSize = layerSize / layerTexels;
+			std::vector<VkBufferImageCopy> bufferCopyRegions;
+			for (uint32_t layer = 0; layer < texLayerCount; layer++) {
+				VkDeviceSize offset = layer * layerSize;
+				for (uint32_t level = 0; level < texMipLevels; level++) {
+					VkBufferImageCopy region = {};
+					region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+					region.imageSubresource.mipLevel = level;
+					region.imageSubresource.baseArrayLayer = layer;
+					region.imageSubresource.layerCount = 1;
+					region.imageExtent.width = std::max(1u, texWidth >> level);
+					region.imageExtent.height = std::max(1u, texHeight >> level);
+					region.imageExtent.depth = 1;
+					region.bufferOffset = offset;
+					bufferCopyRegions.push_back(region);
+					offset += (VkDeviceSize)region.imageExtent.width * region.imageExtent.height * texelSize;
+				}
+			}
 
-			// Update descriptor image info member that can be used for setting up descriptor sets
-			updateDescriptorInfo();
+			fromRegions(buffer, bufferSize, format, texWidth, texHeight, texLayerCount, texMipLevels, bufferCopyRegions,
+				VK_IMAGE_VIEW_TYPE_2D_ARRAY, vdevice, copyQueue, batch);
 		}
 	};
 }
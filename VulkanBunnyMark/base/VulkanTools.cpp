@@ -62,6 +62,20 @@ namespace vks
 			}
 		}
 
+		std::string presentModeString(VkPresentModeKHR presentMode)
+		{
+			switch (presentMode)
+			{
+#define STR(r) case VK_PRESENT_MODE_ ##r ##_KHR: return #r
+				STR(IMMEDIATE);
+				STR(MAILBOX);
+				STR(FIFO);
+				STR(FIFO_RELAXED);
+#undef STR
+			default: return "UNKNOWN_PRESENT_MODE";
+			}
+		}
+
 		VkBool32 getSupportedDepthFormat(VkPhysicalDevice physicalDevice, VkFormat *depthFormat)
 		{
 			// Since all depth formats may be optional, we need to find a suitable depth format to use
@@ -364,11 +378,68 @@ namespace vks
 		}
 #endif
 
+		VkShaderModule createShaderModule(const uint32_t *code, size_t size, VkDevice device)
+		{
+			VkShaderModule shaderModule;
+			VkShaderModuleCreateInfo moduleCreateInfo{};
+			moduleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+			moduleCreateInfo.codeSize = size;
+			moduleCreateInfo.pCode = code;
+
+			VK_CHECK(vkCreateShaderModule(device, &moduleCreateInfo, NULL, &shaderModule));
+
+			return shaderModule;
+		}
+
 		bool fileExists(const std::string &filename)
 		{
 			std::ifstream f(filename.c_str());
 			return !f.fail();
 		}
+
+		std::vector<std::string> listFiles(const std::string &directory, const std::string &extension)
+		{
+			std::vector<std::string> files;
+			auto matches = [&extension](const std::string &name) {
+				return name.size() > extension.size() && name.compare(name.size() - extension.size(), extension.size(), extension) == 0;
+			};
+#if defined(_WIN32)
+			WIN32_FIND_DATAA findData;
+			HANDLE handle = FindFirstFileA((directory + "/*").c_str(), &findData);
+			if (handle != INVALID_HANDLE_VALUE) {
+				do {
+					if (!(findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) && matches(findData.cFileName)) {
+						files.push_back(findData.cFileName);
+					}
+				} while (FindNextFileA(handle, &findData));
+				FindClose(handle);
+			}
+#elif defined(__ANDROID__)
+			// Directories inside the apk, AAssetDir only lists files
+			AAssetDir* assetDir = AAssetManager_openDir(androidApp->activity->assetManager, directory.c_str());
+			if (assetDir) {
+				while (const char* name = AAssetDir_getNextFileName(assetDir)) {
+					if (matches(name)) {
+						files.push_back(name);
+					}
+				}
+				AAssetDir_close(assetDir);
+			}
+#else
+			DIR* dir = opendir(directory.c_str());
+			if (dir) {
+				while (struct dirent* entry = readdir(dir)) {
+					if (entry->d_name[0] != '.' && matches(entry->d_name)) {
+						files.push_back(entry->d_name);
+					}
+				}
+				closedir(dir);
+			}
+#endif
+			// Directory order is unspecified, sort so frame indices are stable between runs
+			std::sort(files.begin(), files.end());
+			return files;
+		}
 	}
 }
 
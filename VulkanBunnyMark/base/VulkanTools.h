@@ -19,6 +19,7 @@
 #include <assert.h>
 #include <stdio.h>
 #include <vector>
+#include <algorithm>
 #include <iostream>
 #include <stdexcept>
 #include <fstream>
@@ -29,6 +30,8 @@
 #elif defined(__ANDROID__)
 #include "VulkanAndroid.h"
 #include <android/asset_manager.h>
+#else
+#include <dirent.h>
 #endif
 
 // Custom define for better code readability
@@ -74,6 +77,9 @@ namespace vks
 		/** @brief Returns the device type as a string */
 		std::string physicalDeviceTypeString(VkPhysicalDeviceType type);
 
+		/** @brief Returns the present mode as a string */
+		std::string presentModeString(VkPresentModeKHR presentMode);
+
 		// Selected a suitable supported depth format starting with 32 bit down to 16 bit
 		// Returns false if none of the depth formats in the list is supported by the device
 		VkBool32 getSupportedDepthFormat(VkPhysicalDevice physicalDevice, VkFormat *depthFormat);
@@ -119,8 +125,13 @@ namespace vks
 #else
 		VkShaderModule loadShader(const char *fileName, VkDevice device);
 #endif
+		// Create a shader module from SPIR-V code in memory, size is in bytes
+		VkShaderModule createShaderModule(const uint32_t *code, size_t size, VkDevice device);
 
 		/** @brief Checks if a file exists */
 		bool fileExists(const std::string &filename);
+
+		/** @brief Returns the sorted names (without path) of the files in a directory ending with extension, e.g. ".png" */
+		std::vector<std::string> listFiles(const std::string &directory, const std::string &extension);
 	}
 }
@@ -88,4 +88,27 @@
 #define KEY_N 0x2D
 #define KEY_O 0x1F
 #define KEY_T 0x11
+
+#elif defined(VK_USE_PLATFORM_XCB_KHR)
+// X11 keycodes (evdev scancode + 8) of a US layout
+#define KEY_ESCAPE 0x9
+#define KEY_F1 0x43
+#define KEY_F2 0x44
+#define KEY_F3 0x45
+#define KEY_F4 0x46
+#define KEY_F5 0x47
+#define KEY_W 0x19
+#define KEY_A 0x26
+#define KEY_S 0x27
+#define KEY_D 0x28
+#define KEY_P 0x21
+#define KEY_SPACE 0x41
+#define KEY_KPADD 0x56
+#define KEY_KPSUB 0x52
+#define KEY_B 0x38
+#define KEY_F 0x29
+#define KEY_L 0x2E
+#define KEY_N 0x39
+#define KEY_O 0x20
+#define KEY_T 0x1C
 #endif
\ No newline at end of file
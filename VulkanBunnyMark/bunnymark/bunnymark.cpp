@@ -2,6 +2,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <memory>
 #include <vector>
 
 #define GLM_FORCE_RADIANS
@@ -10,6 +14,13 @@
 
 #include "VulkanFramework.h"
 
+#include "BakedTexture.hpp"
+#include "ChunkArena.hpp"
+#include "SimdMath.hpp"
+#include "SpriteMesh.hpp"
+#include "TextureAtlas.hpp"
+#include "ThreadPool.hpp"
+#include "TextureStreamer.hpp"
 #include "VulkanBuffer.hpp"
 #include "VulkanDevice.hpp"
 #include "VulkanTexture.hpp"
@@ -19,99 +30,1077 @@
 #define VERTEX_BUFFER_BIND_ID 0
 #define INSTANCE_BUFFER_BIND_ID 1
 
-const float bunniesAddingThreshold = 0.1f; // in seconds
 const float gravity = 0.5f;
-const uint32_t bunniesEachTime = 5000;
+const float pi = 3.14159265358979f;
+// Large spawns are split into ranges of this many bunnies for the spawn workers
+const uint32_t spawnGrain = 16384;
 
 inline float rrand() { return (float)rand() / (float)RAND_MAX; }
 inline float rrand(float a, float b) {
     float r = (float)rand() / (float)RAND_MAX;
     return a + r * (b - a);
 }
+// RAND_MAX may be as small as 32767, combine two draws for large populations
+inline uint32_t rrandIndex(uint32_t n) {
+    return (uint32_t)((((uint64_t)rand() << 15) ^ (uint64_t)rand()) % n);
+}
+// Stateless integer hash (lowbias32), every random number only depends on its index,
+// so loops drawing from it have no carried dependency and vectorize
+inline uint32_t hash32(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+// [0, 1) from the upper 24 bits of the hash
+inline float hrand(uint32_t index) {
+    return (float)(hash32(index) >> 8) * (1.0f / 16777216.0f);
+}
 
 struct VertexData {
     glm::vec4 inPositionTexcoord;
 };
 
-struct SpriteData {
-    glm::mat2 inSpriteScaleRotation;
-    glm::vec2 inSpritePosition;
+// Number of bunny frames in the texture
+const uint32_t frameCount = 5;
+// The frames are packed without borders and only 2 texels apart. Level 1 texels still cover a single frame or the gap, below
+// that the box filter and bilinear sampling blend neighbouring frames, so bunny sheets stop at two mip levels
+const uint32_t sheetMipLevels = 2;
+// Upper bound for -spritemesh, more vertices stop paying off against the saved fragments
+const uint32_t maxMeshVertices = 16;
+// Instances per draw of the front to back pass of the depth tested alpha modes, which records the ranges of a chunk in reverse
+const uint32_t frontToBackRange = 256;
+
+// Shader variant axes, each one maps to a specialization constant of sprite.vert / sprite.frag
+enum class InstanceFormat : uint32_t { full, quantized };
+enum class TransformMode : uint32_t { matrix, angle };
+enum class UvSource : uint32_t { perDraw, perInstance };
+// depth: alpha test with depth writes, drawn front to back so stacked sprites fail the early depth test, depthBlend: the same
+// followed by blending the soft edges the alpha test dropped
+enum class AlphaMode : uint32_t { blend, discard, depth, depthBlend };
+// Pipelines of a variant, only AlphaMode::depthBlend draws the edges pass after the sprites
+enum class SpritePass : uint32_t { sprites, edges };
+// Multiple sprite sheets drawn in one call: layers of one array texture or one descriptor per sheet (VK_EXT_descriptor_indexing)
+enum class SheetMode : uint32_t { single, array, bindless };
+// Where sprite.vert finds the texture rectangle of a sprite: the bunny frames in the push constants or the frame table of an atlas
+enum class SpriteSource : uint32_t { bunnies, atlas };
+
+// Upper bound for -sheets, every sheet adds frameCount sprites
+const uint32_t maxSheets = 1024;
+// Sprite indices are stored as raw integers in the 16 bit snorm instance format
+const uint32_t maxSprites = 32767;
+// Largest atlas page, clamped to the device limit
+const uint32_t atlasPageSize = 4096;
+
+struct ShaderVariant {
+    InstanceFormat instanceFormat = InstanceFormat::full;
+    TransformMode transform = TransformMode::matrix;
+    UvSource uvSource = UvSource::perDraw;
+    AlphaMode alphaMode = AlphaMode::blend;
+    // Chosen at startup, multiple sheets and atlases require per-instance UVs
+    SheetMode sheetMode = SheetMode::single;
+    SpriteSource spriteSource = SpriteSource::bunnies;
+
+    // The alpha, sheet and sprite source settings don't change the instance data
+    uint32_t packingIndex() const {
+        return (uint32_t)instanceFormat | ((uint32_t)transform << 1) | ((uint32_t)uvSource << 2);
+    }
+    uint32_t key() const {
+        return packingIndex() | ((uint32_t)alphaMode << 3) | ((uint32_t)sheetMode << 5) | ((uint32_t)spriteSource << 7);
+    }
+    bool depthTested() const {
+        return alphaMode == AlphaMode::depth || alphaMode == AlphaMode::depthBlend;
+    }
 };
 
-struct Sprite {
-    float x, y;
-    float scale;
-    float rotation;
-    SpriteData* renderData = nullptr;
-    // bunny.speedX, bunny.speedY
-    float speedX, speedY;
+// Ranges of the 16 bit snorm instance format, must match sprite.vert
+const float quantizedPositionRange = 4096.f;
+const float quantizedRotationRange = pi;
+const float quantizedScaleRange = 2.f;
+const float snormMax = 32767.f;
+
+inline int16_t quantizeSnorm(float v) {
+    v = std::max(-1.f, std::min(v, 1.f));
+    return (int16_t)(v * snormMax + (v < 0.f ? -0.5f : 0.5f));
+}
+
+struct BunnyChunk;
+
+// Sprite of a spawned bunny: (batch frame + random choice * stride) % count
+struct SpriteSet {
+    uint32_t choices = 1;
+    uint32_t stride = 0;
+    uint32_t count = frameCount;
+};
+
+// Frame table entry read by sprite.vert when drawing from an atlas, matches its std430 layout
+struct SpriteFrame {
+    glm::vec4 rect;     // texture offset and size, normalized
+    glm::vec2 size;     // quad size in pixels
+    float page;         // layer of the array texture
+    float padding;
+};
+
+// Instance data layout of a shader variant: attribute A (location 1) at offset 0, attribute B (location 2) at offsetB
+struct InstancePacking {
+    uint32_t stride;
+    VkFormat formatA;
+    VkFormat formatB;
+    uint32_t offsetB;
+    // Writes the data that changes every frame
+    void (*packPositions)(BunnyChunk& chunk, uint32_t begin, uint32_t end);
+    // Writes rotation, scale and frame, only needed again when they are animated
+    void (*packTransforms)(BunnyChunk& chunk, uint32_t begin, uint32_t end);
+};
+
+// Largest stride of all variants (float matrix, position and frame)
+const uint32_t maxInstanceStride = 28;
+
+// A fixed-size block of bunnies carved out of the chunk arena. Simulation state is stored as
+// structure of arrays, followed by the instance data that is copied to the GPU every frame.
+// Chunks never move once created, appending bunnies only touches the tail chunk of a batch.
+struct BunnyChunk {
+    uint32_t count = 0;
+    uint32_t capacity = 0;
+    // Texture frame of the owning batch
+    uint32_t frame = 0;
+    // Stride of the active instance layout, set when the chunk is acquired or repacked
+    uint32_t instanceStride = 0;
+    float* x;
+    float* y;
+    float* speedX;
+    float* speedY;
+    float* scale;
+    float* rotation;
+    float* spin;
+    float* scaleSpeed;
+    // Sprite index written to the instance data with per-instance UVs
+    uint32_t* sprite;
+    uint8_t* instanceData;
+    vks::Buffer instanceBuffer;
 
-    void setRenderData(SpriteData* data) {
-        if (data) {
-            renderData = data;
-            renderData->inSpritePosition = glm::vec2(x, y);
-            updateScaleRotation();
+    // Instance buffers hold one copy of the instance data per slot, see VulkanDemo::instanceSlots
+    static BunnyChunk* create(vks::ChunkArena& arena, vks::VulkanDevice* vdevice, uint32_t slots) {
+        const size_t stateArrays = 9;
+        const size_t bytesPerBunny = stateArrays * sizeof(float) + maxInstanceStride;
+        size_t headerSize = vks::ChunkArena::alignUp(sizeof(BunnyChunk));
+        uint8_t* mem = (uint8_t*)arena.allocate();
+
+        BunnyChunk* chunk = new (mem) BunnyChunk();
+        // Multiples of 16 bunnies keep every array cache line aligned
+        chunk->capacity = (uint32_t)(((arena.getChunkSize() - headerSize) / bytesPerBunny) & ~(size_t)15);
+        float* p = (float*)(mem + headerSize);
+        chunk->x = p; p += chunk->capacity;
+        chunk->y = p; p += chunk->capacity;
+        chunk->speedX = p; p += chunk->capacity;
+        chunk->speedY = p; p += chunk->capacity;
+        chunk->scale = p; p += chunk->capacity;
+        chunk->rotation = p; p += chunk->capacity;
+        chunk->spin = p; p += chunk->capacity;
+        chunk->scaleSpeed = p; p += chunk->capacity;
+        chunk->sprite = (uint32_t*)p; p += chunk->capacity;
+        chunk->instanceData = (uint8_t*)p;
+        chunk->instanceBuffer.create(vdevice, vks::BufferType::transient, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, chunk->capacity * maxInstanceStride * slots, true);
+        return chunk;
+    }
+    // Initializes the bunnies [begin, end), serial is the global spawn index of the first one
+    void spawn(uint32_t begin, uint32_t end, uint32_t serial, const SpriteSet& sprites, const InstancePacking& packing) {
+        const uint32_t randsPerBunny = 7;
+        uint32_t seed = (serial - begin) * randsPerBunny;
+        for (uint32_t i = begin; i < end; ++i) {
+            uint32_t r = seed + i * randsPerBunny;
+            x[i] = 0.f;
+            y[i] = 0.f;
+            speedX[i] = hrand(r) * 10;
+            speedY[i] = hrand(r + 1) * 10 - 5;
+            scale[i] = 0.5f + hrand(r + 2) * 0.5f;
+            rotation[i] = hrand(r + 3) - 0.5f;
+            // Only used with -animate, radians and scale units per 60 fps frame
+            spin[i] = (hrand(r + 4) - 0.5f) * 0.2f;
+            scaleSpeed[i] = (hrand(r + 5) - 0.5f) * 0.02f;
+            uint32_t choice = (sprites.choices > 1) ? hash32(r + 6) % sprites.choices : 0;
+            sprite[i] = (frame + choice * sprites.stride) % sprites.count;
         }
+        packing.packPositions(*this, begin, end);
+        packing.packTransforms(*this, begin, end);
     }
-    void setPosition(float px, float py) {
-        x = px; y = py;
-        updatePosition();
+    // Rewrites all instance data after the shader variant changed
+    void repack(const InstancePacking& packing) {
+        instanceStride = packing.stride;
+        packing.packPositions(*this, 0, count);
+        packing.packTransforms(*this, 0, count);
     }
-    void setScale(float s) {
-        if (scale != s) {
-            scale = s;
-            updateScaleRotation();
-        }
+    // The chunk memory itself is owned by the arena
+    void destroy() {
+        instanceBuffer.destroy();
+        this->~BunnyChunk();
+    }
+    inline bool full() const { return count == capacity; }
+    // Copies bunny src of chunk from into slot dst of this chunk
+    inline void copyBunny(uint32_t dst, const BunnyChunk& from, uint32_t src) {
+        x[dst] = from.x[src];
+        y[dst] = from.y[src];
+        speedX[dst] = from.speedX[src];
+        speedY[dst] = from.speedY[src];
+        scale[dst] = from.scale[src];
+        rotation[dst] = from.rotation[src];
+        spin[dst] = from.spin[src];
+        scaleSpeed[dst] = from.scaleSpeed[src];
+        sprite[dst] = from.sprite[src];
+        memcpy(instanceData + dst * instanceStride, from.instanceData + src * from.instanceStride, instanceStride);
+    }
+    inline VkDeviceSize slotOffset(uint32_t slot) const {
+        return (VkDeviceSize)slot * capacity * maxInstanceStride;
     }
-    void setRotation(float r) {
-        if (rotation != r) {
-            rotation = r;
-            updateScaleRotation();
+    void flush(uint32_t slot) {
+        memcpy((uint8_t*)instanceBuffer.mappedData + slotOffset(slot), instanceData, count * instanceStride);
+    }
+};
+
+// Instance data packing of one shader variant. The variant is a compile time constant, so the
+// conditions below fold away and every packing loop is branch free.
+//
+//                      attribute A (location 1)         attribute B (location 2)
+//   full,  matrix      mat2 float                       position float, frame float
+//   full,  angle       position, rotation, scale float  frame float
+//   quantized, matrix  mat2 snorm16                     position snorm16, frame snorm16
+//   quantized, angle   position, rotation, scale snorm16  frame snorm16
+//
+// Without per-instance UVs the frame is dropped, variants left with no B data point B at A (the shader ignores it).
+// The frame field holds the sprite index, with multiple sheets that is frame + sheet * frameCount.
+template <InstanceFormat Format, TransformMode Transform, UvSource Uv>
+struct InstancePacker {
+    static const bool quantized = Format == InstanceFormat::quantized;
+    static const bool angle = Transform == TransformMode::angle;
+    static const bool perInstanceUv = Uv == UvSource::perInstance;
+    static const uint32_t elementSize = quantized ? sizeof(int16_t) : sizeof(float);
+    static const uint32_t sizeA = 4 * elementSize;
+    static const uint32_t positionOffset = angle ? 0 : sizeA;
+    static const uint32_t frameOffset = angle ? sizeA : sizeA + 2 * elementSize;
+    static const uint32_t stride = perInstanceUv ? frameOffset + (quantized ? 2 * elementSize : elementSize) : (angle ? sizeA : frameOffset);
+
+    static void packPositions(BunnyChunk& chunk, uint32_t begin, uint32_t end) {
+        uint8_t* dst = chunk.instanceData + positionOffset;
+        for (uint32_t i = begin; i < end; ++i) {
+            if (quantized) {
+                int16_t* p = (int16_t*)(dst + i * stride);
+                p[0] = quantizeSnorm(chunk.x[i] * (1.f / quantizedPositionRange));
+                p[1] = quantizeSnorm(chunk.y[i] * (1.f / quantizedPositionRange));
+            }
+            else {
+                float* p = (float*)(dst + i * stride);
+                p[0] = chunk.x[i];
+                p[1] = chunk.y[i];
+            }
         }
     }
-    inline void updatePosition() {
-        if (renderData) {
-            renderData->inSpritePosition.x = x;
-            renderData->inSpritePosition.y = y;
+
+    static void packTransforms(BunnyChunk& chunk, uint32_t begin, uint32_t end) {
+        uint8_t* dst = chunk.instanceData;
+        if (!angle && !quantized) {
+            vks::simd::buildScaleRotation(chunk.scale + begin, chunk.rotation + begin, (float*)(dst + begin * stride),
+                stride / sizeof(float), end - begin);
+        }
+        else if (!angle) {
+            const uint32_t blockSize = 256;
+            float sinr[blockSize];
+            float cosr[blockSize];
+            for (uint32_t block = begin; block < end; block += blockSize) {
+                uint32_t n = std::min(blockSize, end - block);
+                vks::simd::sincos(chunk.rotation + block, sinr, cosr, n);
+                for (uint32_t k = 0; k < n; ++k) {
+                    int16_t* m = (int16_t*)(dst + (block + k) * stride);
+                    float s = chunk.scale[block + k];
+                    m[0] = quantizeSnorm(s * cosr[k]);
+                    m[1] = quantizeSnorm(-s * sinr[k]);
+                    m[2] = quantizeSnorm(s * sinr[k]);
+                    m[3] = m[0];
+                }
+            }
+        }
+        else {
+            for (uint32_t i = begin; i < end; ++i) {
+                if (quantized) {
+                    int16_t* p = (int16_t*)(dst + i * stride);
+                    p[2] = quantizeSnorm(chunk.rotation[i] * (1.f / quantizedRotationRange));
+                    p[3] = quantizeSnorm(chunk.scale[i] * (1.f / quantizedScaleRange));
+                }
+                else {
+                    float* p = (float*)(dst + i * stride);
+                    p[2] = chunk.rotation[i];
+                    p[3] = chunk.scale[i];
+                }
+            }
+        }
+        if (perInstanceUv) {
+            for (uint32_t i = begin; i < end; ++i) {
+                if (quantized) {
+                    // Raw integer, the shader rescales by snormMax
+                    int16_t* p = (int16_t*)(dst + i * stride + frameOffset);
+                    p[0] = (int16_t)chunk.sprite[i];
+                    p[1] = 0;
+                }
+                else {
+                    *(float*)(dst + i * stride + frameOffset) = (float)chunk.sprite[i];
+                }
+            }
         }
     }
-    inline void updateScaleRotation() {
-        if (renderData) {
-            glm::mat2 scalemat = glm::mat2(scale, 0.f, 0.f, scale);
-            float sinr = std::sinf(rotation);
-            float cosr = std::cosf(rotation);
-            glm::mat2 rotmat = glm::mat2(cosr, -sinr, sinr, cosr);
-            renderData->inSpriteScaleRotation = scalemat * rotmat;
+
+    static InstancePacking describe() {
+        InstancePacking packing;
+        packing.stride = stride;
+        packing.formatA = quantized ? VK_FORMAT_R16G16B16A16_SNORM : VK_FORMAT_R32G32B32A32_SFLOAT;
+        if (angle) {
+            packing.formatB = quantized ? VK_FORMAT_R16G16_SNORM : VK_FORMAT_R32_SFLOAT;
+            packing.offsetB = perInstanceUv ? sizeA : 0;
         }
+        else {
+            if (quantized) {
+                packing.formatB = perInstanceUv ? VK_FORMAT_R16G16B16A16_SNORM : VK_FORMAT_R16G16_SNORM;
+            }
+            else {
+                packing.formatB = perInstanceUv ? VK_FORMAT_R32G32B32_SFLOAT : VK_FORMAT_R32G32_SFLOAT;
+            }
+            packing.offsetB = sizeA;
+        }
+        packing.packPositions = &packPositions;
+        packing.packTransforms = &packTransforms;
+        return packing;
     }
 };
 
+// Indexed by ShaderVariant::packingIndex()
+inline const InstancePacking& instancePacking(const ShaderVariant& variant) {
+    static const InstancePacking table[8] = {
+        InstancePacker<InstanceFormat::full, TransformMode::matrix, UvSource::perDraw>::describe(),
+        InstancePacker<InstanceFormat::quantized, TransformMode::matrix, UvSource::perDraw>::describe(),
+        InstancePacker<InstanceFormat::full, TransformMode::angle, UvSource::perDraw>::describe(),
+        InstancePacker<InstanceFormat::quantized, TransformMode::angle, UvSource::perDraw>::describe(),
+        InstancePacker<InstanceFormat::full, TransformMode::matrix, UvSource::perInstance>::describe(),
+        InstancePacker<InstanceFormat::quantized, TransformMode::matrix, UvSource::perInstance>::describe(),
+        InstancePacker<InstanceFormat::full, TransformMode::angle, UvSource::perInstance>::describe(),
+        InstancePacker<InstanceFormat::quantized, TransformMode::angle, UvSource::perInstance>::describe(),
+    };
+    return table[variant.packingIndex()];
+}
+
+struct SimulationParams {
+    float d;            // frame time in 60 fps frames
+    float gravity;      // gravity * d
+    float maxX;
+    float maxY;
+    float restitution;  // speed kept when bouncing off the floor
+    uint32_t kickSeed;  // hash offset of the random floor kicks
+};
+
+// Runtime settings selecting a simulation kernel, see simulationKernel()
+struct SimulationFeatures {
+    bool gravity = true;
+    bool restitution = true;
+    bool kick = true;
+    bool rotate = false;
+    bool scale = false;
+    uint32_t simdWidth = 8;
+};
+
+// Stateless hash of the lanes of an integer register, same results as hash32()
+template <typename Ops>
+inline typename Ops::I hash32(typename Ops::I x) {
+    x = Ops::xori(x, Ops::template srli<16>(x));
+    x = Ops::mulu(x, Ops::seti((int32_t)0x7feb352du));
+    x = Ops::xori(x, Ops::template srli<15>(x));
+    x = Ops::mulu(x, Ops::seti((int32_t)0x846ca68bu));
+    x = Ops::xori(x, Ops::template srli<16>(x));
+    return x;
+}
+
+// Moves the Ops::width bunnies starting at i. Branch free, bounces are applied through lane masks.
+// The feature flags are compile time constants and disappear from the generated code
+template <typename Ops, bool Gravity, bool Restitution, bool Kick, bool Rotate, bool Scale>
+inline void simulateBlock(BunnyChunk& chunk, uint32_t i, const SimulationParams& p) {
+    typedef typename Ops::F F;
+    const F d = Ops::set(p.d);
+    const F zero = Ops::set(0.f);
+    const F maxX = Ops::set(p.maxX);
+    const F maxY = Ops::set(p.maxY);
+
+    F speedX = Ops::load(chunk.speedX + i);
+    F speedY = Ops::load(chunk.speedY + i);
+    F x = Ops::add(Ops::load(chunk.x + i), Ops::mul(speedX, d));
+    F y = Ops::add(Ops::load(chunk.y + i), Ops::mul(speedY, d));
+    if (Gravity) {
+        speedY = Ops::add(speedY, Ops::set(p.gravity));
+    }
+
+    F outX = Ops::bitOr(Ops::cmpgt(x, maxX), Ops::cmplt(x, zero));
+    speedX = Ops::select(outX, Ops::sub(zero, speedX), speedX);
+    x = Ops::min(Ops::max(x, zero), maxX);
+
+    F bounce = Restitution ? Ops::mul(speedY, Ops::set(-p.restitution)) : Ops::sub(zero, speedY);
+    if (Kick) {
+        // Half of the bounces get an extra kick of up to 6 (pixijs: if (Math.random() > 0.5) speedY -= Math.random() * 6)
+        typename Ops::I h = hash32<Ops>(Ops::addi(Ops::seti((int32_t)(p.kickSeed + i)), Ops::iota()));
+        F r = Ops::mul(Ops::toFloat(Ops::template srli<8>(h)), Ops::set(1.0f / 16777216.0f));
+        F kick = Ops::bitAnd(Ops::cmplt(r, Ops::set(0.5f)), Ops::mul(r, Ops::set(12.f)));
+        bounce = Ops::sub(bounce, kick);
+    }
+    speedY = Ops::select(Ops::cmpgt(y, maxY), bounce, speedY);
+    speedY = Ops::select(Ops::cmplt(y, zero), zero, speedY);
+    y = Ops::min(Ops::max(y, zero), maxY);
+
+    Ops::store(chunk.x + i, x);
+    Ops::store(chunk.y + i, y);
+    Ops::store(chunk.speedX + i, speedX);
+    Ops::store(chunk.speedY + i, speedY);
+
+    if (Rotate) {
+        // Keep angles wrapped, the polynomial sincos is only accurate for moderate arguments
+        const F twoPi = Ops::set(2 * pi);
+        F rotation = Ops::add(Ops::load(chunk.rotation + i), Ops::mul(Ops::load(chunk.spin + i), d));
+        rotation = Ops::select(Ops::cmpgt(rotation, Ops::set(pi)), Ops::sub(rotation, twoPi), rotation);
+        rotation = Ops::select(Ops::cmplt(rotation, Ops::set(-pi)), Ops::add(rotation, twoPi), rotation);
+        Ops::store(chunk.rotation + i, rotation);
+    }
+    if (Scale) {
+        const F minScale = Ops::set(0.5f);
+        const F maxScale = Ops::set(1.f);
+        F scaleSpeed = Ops::load(chunk.scaleSpeed + i);
+        F scale = Ops::add(Ops::load(chunk.scale + i), Ops::mul(scaleSpeed, d));
+        F outside = Ops::bitOr(Ops::cmpgt(scale, maxScale), Ops::cmplt(scale, minScale));
+        Ops::store(chunk.scaleSpeed + i, Ops::select(outside, Ops::sub(zero, scaleSpeed), scaleSpeed));
+        Ops::store(chunk.scale + i, Ops::min(Ops::max(scale, minScale), maxScale));
+    }
+}
+
+// Full blocks use the Width lane registers, the remainder of the chunk runs through the scalar path
+template <bool Gravity, bool Restitution, bool Kick, bool Rotate, bool Scale, uint32_t Width>
+void simulateChunk(BunnyChunk& chunk, const SimulationParams& p) {
+    typedef typename vks::simd::Lanes<Width>::Ops Ops;
+    typedef vks::simd::Lanes<1>::Ops ScalarOps;
+    const uint32_t count = chunk.count;
+    uint32_t i = 0;
+    for (; i + Ops::width <= count; i += Ops::width) {
+        simulateBlock<Ops, Gravity, Restitution, Kick, Rotate, Scale>(chunk, i, p);
+    }
+    for (; i < count; ++i) {
+        simulateBlock<ScalarOps, Gravity, Restitution, Kick, Rotate, Scale>(chunk, i, p);
+    }
+}
+
+typedef void (*SimulateFn)(BunnyChunk& chunk, const SimulationParams& p);
+
+const uint32_t simdWidths[] = { 1, 4, 8 };
+const uint32_t simulationKernelCount = 32 * 3;
+
+// Table index: bit 0 gravity, 1 restitution, 2 kick, 3 rotate, 4 scale, bits 5-6 index into simdWidths
+template <uint32_t Index>
+struct SimulationKernel {
+    static const uint32_t width = (Index >> 5) == 0 ? 1 : (Index >> 5) == 1 ? 4 : 8;
+    static void fill(SimulateFn* table) {
+        table[Index] = &simulateChunk<(Index & 1) != 0, (Index & 2) != 0, (Index & 4) != 0, (Index & 8) != 0, (Index & 16) != 0, width>;
+        SimulationKernel<Index - 1>::fill(table);
+    }
+};
+template <>
+struct SimulationKernel<0> {
+    static void fill(SimulateFn* table) {
+        table[0] = &simulateChunk<false, false, false, false, false, 1>;
+    }
+};
+
+struct SimulationKernelTable {
+    SimulateFn kernels[simulationKernelCount];
+
+    SimulationKernelTable() { SimulationKernel<simulationKernelCount - 1>::fill(kernels); }
+};
+
+// Lane count the kernels of a requested width actually run with on this build
+inline uint32_t simulationLanes(uint32_t simdWidth) {
+    if (simdWidth >= 8) {
+        return vks::simd::Lanes<8>::Ops::width;
+    }
+    return (simdWidth >= 4) ? vks::simd::Lanes<4>::Ops::width : 1;
+}
+
+inline SimulateFn simulationKernel(const SimulationFeatures& features) {
+    static const SimulationKernelTable table;
+    uint32_t widthIndex = 0;
+    while (widthIndex + 1 < 3 && simdWidths[widthIndex + 1] <= features.simdWidth) {
+        widthIndex++;
+    }
+    uint32_t index = (features.gravity ? 1 : 0) | (features.restitution ? 2 : 0) | (features.kick ? 4 : 0) |
+        (features.rotate ? 8 : 0) | (features.scale ? 16 : 0) | (widthIndex << 5);
+    return table.kernels[index];
+}
+
+// All chunks of a batch are full except the last one, so a bunny index maps directly to chunk and slot
 struct SpriteBatch {
     uint32_t texId;
-
-    std::vector<SpriteData> spriteDatas;
-    std::vector<Sprite> sprites;
-    vks::Buffer instanceBuffer;
+    uint32_t count = 0;
+    std::vector<BunnyChunk*> chunks;
 
     SpriteBatch(uint32_t type) : texId(type) {}
+};
+
+// What command buffer recording needs from the simulation. With a render thread it is copied while that thread
+// is blocked, so recording never looks at batches and chunks the simulation is changing.
+struct FrameSnapshot {
+    struct Draw {
+        VkBuffer buffer;
+        VkDeviceSize offset;
+        uint32_t count;
+        // Draws with the instance count in this buffer instead of count when set
+        VkBuffer indirectBuffer;
+        // Offset of a copy of the instances in reverse order, 0 if there is none
+        VkDeviceSize reversedOffset;
+    };
+    struct Batch {
+        uint32_t texId;
+        uint32_t firstDraw;
+        uint32_t drawCount;
+    };
+    std::vector<Batch> batches;
+    std::vector<Draw> draws;
+    ShaderVariant variant;
+    VkDescriptorSet descriptorSet;
+    // Instance buffer slot the draws read
+    uint32_t slot;
+    // Input sample the simulated state is based on
+    vks::FramePacer::Clock::time_point inputTime;
+};
+
+// Bunny state of the GPU simulation, matches the std430 layout of simulate.comp
+struct GpuBunny {
+    glm::vec2 position;
+    glm::vec2 speed;
+    float rotation;
+    float scale;
+    float spin;
+    float scaleSpeed;
+    uint32_t sprite;
+    uint32_t padding;
+};
+
+// Push constants of simulate.comp
+struct StepParams {
+    SimulationParams simulation;
+    uint32_t reversedFirst; // first instance of the copy in reverse order, 0 skips it
+};
+
+// Push constants of spawn.comp. New bunnies either overwrite [first, first + count) or, with first = appendSpawn, are
+// appended at the bunny count in device memory
+const uint32_t appendSpawn = 0xffffffffu;
+struct SpawnParams {
+    uint32_t first;
+    uint32_t count;
+    uint32_t serial;        // global spawn index of the first bunny, seeds its random numbers
+    uint32_t spriteFrame;
+    uint32_t choices;       // SpriteSet
+    uint32_t stride;
+    uint32_t spriteCount;
+};
+
+// Moves the bunnies with simulate.comp on the compute queue, which has a queue family of its own on most desktop GPUs.
+// The state never leaves device memory. Every step writes the instance data of its frame into one of two instance
+// buffers, so the simulation of the next frame runs while the graphics queue draws the previous step from the other one.
+// Both queue families share the instance buffers concurrently, so no ownership transfers are needed. Timelines order the
+// two queues: a step waits for the frame that last drew its instance buffer, and a frame waits for the step it draws.
+//
+// New bunnies are initialized on the device by spawn.comp. It draws the same hashed random numbers as BunnyChunk::spawn()
+// and appends through an atomic bunny count, which each step turns into the indirect draw of its frame. A spawn burst is
+// one dispatch, with no CPU work or upload.
+class ComputeSimulation {
+public:
+    // Instance buffers written by alternating steps
+    static const uint32_t stepSlots = 2;
+    // Timestamps are read a few steps late instead of waiting for them
+    static const uint32_t timingSlots = 4;
+    static const uint32_t workgroupSize = 256;
+    static const uint32_t minCapacity = 1 << 16;
+    // Full, angle, per-instance UV layout written by simulate.comp
+    static const uint32_t instanceStride = 5 * sizeof(float);
+
+    uint32_t count = 0;
+
+    ~ComputeSimulation()
+    {
+        if (device == VK_NULL_HANDLE) {
+            return;
+        }
+        state.destroy();
+        grownFrom.destroy();
+        counter.destroy();
+        for (auto& buffer : instances) {
+            buffer.destroy();
+        }
+        for (auto& buffer : indirectDraws) {
+            buffer.destroy();
+        }
+        for (auto& retiredBuffer : retired) {
+            retiredBuffer.buffer.destroy();
+        }
+        vkDestroyPipeline(device, pipeline, nullptr);
+        vkDestroyPipeline(device, spawnPipeline, nullptr);
+        vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+        vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+        vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+        vkDestroyCommandPool(device, commandPool, nullptr);
+        if (queryPool != VK_NULL_HANDLE) {
+            vkDestroyQueryPool(device, queryPool, nullptr);
+        }
+    }
+
+    // Steps are submitted through the compute timeline, frames through the frame timeline
+    void prepare(vks::VulkanDevice* vulkanDevice, vks::TimelineSemaphore* computeTimeline, vks::TimelineSemaphore* frameTimeline, VkPipelineCache pipelineCache,
+        const VkPipelineShaderStageCreateInfo& simulateStage, const VkPipelineShaderStageCreateInfo& spawnStage, const SimulationFeatures& features,
+        uint32_t drawIndexCount)
+    {
+        vdevice = vulkanDevice;
+        indexCount = drawIndexCount;
+        device = vulkanDevice->device;
+        compute = computeTimeline;
+        frame = frameTimeline;
+        const uint32_t graphicsFamily = vdevice->queueFamilyIndices.graphics;
+        const uint32_t computeFamily = vdevice->queueFamilyIndices.compute;
+        queueFamilies.push_back(graphicsFamily);
+        if (computeFamily != graphicsFamily) {
+            queueFamilies.push_back(computeFamily);
+        }
+
+        commandPool = vdevice->createCommandPool(computeFamily);
+        VkCommandBufferAllocateInfo allocInfo = vks::initializers::commandBufferAllocateInfo(commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, stepSlots);
+        VK_CHECK(vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data()));
 
-    void initSprites(vks::VulkanDevice* vdevice, const std::vector<Sprite>& sprs) {
-        spriteDatas.resize(sprs.size());
-        sprites.insert(sprites.end(), sprs.begin(), sprs.end());
-        for (int i = 0; i < sprites.size(); ++i) {
-            sprites[i].setRenderData(&spriteDatas[i]);
+        std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+            // Binding 0 : bunny state
+            vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+            // Binding 1 : instance data
+            vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+            // Binding 2 : bunny count
+            vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+            // Binding 3 : indirect draw
+            vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3)
+        };
+        VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
+        VK_CHECK(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
+        // Both shaders share the layout, each one reads its own push constants
+        VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT,
+            (uint32_t)std::max(sizeof(StepParams), sizeof(SpawnParams)), 0);
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+        VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout));
+
+        // One set per step slot, rewritten before every step as the buffers are replaced when the population grows
+        std::vector<VkDescriptorPoolSize> poolSizes = {
+            vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4 * stepSlots)
+        };
+        VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, stepSlots);
+        VK_CHECK(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
+        std::array<VkDescriptorSetLayout, stepSlots> setLayouts;
+        setLayouts.fill(descriptorSetLayout);
+        VkDescriptorSetAllocateInfo setAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, setLayouts.data(), stepSlots);
+        VK_CHECK(vkAllocateDescriptorSets(device, &setAllocInfo, descriptorSets.data()));
+
+        // Like the template flags of the CPU kernels, disabled features are compiled out of the shader
+        std::array<VkBool32, 5> specializationData = { features.gravity, features.restitution, features.kick, features.rotate, features.scale };
+        std::array<VkSpecializationMapEntry, 5> specializationMapEntries;
+        for (uint32_t i = 0; i < specializationMapEntries.size(); i++) {
+            specializationMapEntries[i] = vks::initializers::specializationMapEntry(i, i * sizeof(VkBool32), sizeof(VkBool32));
+        }
+        VkSpecializationInfo specializationInfo = vks::initializers::specializationInfo(
+            static_cast<uint32_t>(specializationMapEntries.size()), specializationMapEntries.data(), sizeof(specializationData), specializationData.data());
+        VkComputePipelineCreateInfo pipelineCreateInfo = vks::initializers::computePipelineCreateInfo(pipelineLayout);
+        pipelineCreateInfo.stage = simulateStage;
+        pipelineCreateInfo.stage.pSpecializationInfo = &specializationInfo;
+        VK_CHECK(vkCreateComputePipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipeline));
+        pipelineCreateInfo.stage = spawnStage;
+        VK_CHECK(vkCreateComputePipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &spawnPipeline));
+
+        counter.create(vdevice, vks::BufferType::device, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, sizeof(uint32_t));
+        for (auto& buffer : indirectDraws) {
+            buffer.create(vdevice, vks::BufferType::device, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                sizeof(VkDrawIndexedIndirectCommand), false, queueFamilies);
+        }
+        // The first step clears the count
+        SpawnOp clear = { SpawnOp::truncate, 0 };
+        ops.push_back(clear);
+
+        // The overlap is measured with timestamps from both queues. Strictly, Vulkan only orders the timestamps of one queue,
+        // but the queues of a device share its clock (the device time domain of VK_EXT_calibrated_timestamps).
+        const uint32_t validBits = std::min(vdevice->queueFamilyProperties[computeFamily].timestampValidBits,
+            vdevice->queueFamilyProperties[graphicsFamily].timestampValidBits);
+        if (validBits > 0 && vdevice->properties.limits.timestampPeriod > 0.f) {
+            VkQueryPoolCreateInfo queryPoolInfo = { VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+            queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+            // Per timing slot: step begin and end on the compute queue, frame begin and end on the graphics queue
+            queryPoolInfo.queryCount = 4 * timingSlots;
+            VK_CHECK(vkCreateQueryPool(device, &queryPoolInfo, nullptr, &queryPool));
+            timestampMask = (validBits >= 64) ? ~0ull : (1ull << validBits) - 1;
+            timestampPeriod = vdevice->properties.limits.timestampPeriod;
+            computeSteps.fill(UINT32_MAX);
+            drawnSteps.fill(UINT32_MAX);
         }
-        instanceBuffer.create(vdevice, vks::BufferType::transient, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, spriteDatas.size() * sizeof(SpriteData), true);
     }
-    inline size_t size() { return sprites.size(); }
-    void flush() {
-        memcpy(instanceBuffer.mappedData, spriteDatas.data(), spriteDatas.size() * sizeof(SpriteData));
+
+    // Appends n new bunnies, serial is the global spawn index of the first one. The next step spawns them on the device.
+    void spawn(uint32_t n, uint32_t serial, uint32_t spriteFrame, const SpriteSet& sprites)
+    {
+        reserve(count + n);
+        addSpawn(appendSpawn, n, serial, spriteFrame, sprites);
+        count += n;
+    }
+
+    // Replaces n bunnies with new ones, moving through the population so churn doesn't keep hitting the same bunnies
+    void respawn(uint32_t n, uint32_t serial, uint32_t spriteFrame, const SpriteSet& sprites)
+    {
+        n = std::min(n, count);
+        while (n > 0) {
+            respawnCursor %= count;
+            const uint32_t run = std::min(n, count - respawnCursor);
+            addSpawn(respawnCursor, run, serial, spriteFrame, sprites);
+            respawnCursor += run;
+            serial += run;
+            n -= run;
+        }
+    }
+
+    // Drops the newest bunnies, the state of the survivors stays where it is
+    void remove(uint32_t n)
+    {
+        count -= std::min(n, count);
+        SpawnOp op = { SpawnOp::truncate, count };
+        ops.push_back(op);
+    }
+
+    // Records and submits one step, the frames after it draw its instances. With reversed set the step also writes them
+    // in reverse order behind the capacity, for the front to back pass of the depth tested alpha modes.
+    void step(const SimulationParams& simulation, bool reversed)
+    {
+        const uint32_t slot = stepIndex % stepSlots;
+        // The step two back used the command buffer and descriptor set of this slot
+        compute->wait(slotComputeValues[slot]);
+        readTimestamps();
+        releaseRetired();
+
+        std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+            vks::initializers::writeDescriptorSet(descriptorSets[slot], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &state.descriptor),
+            vks::initializers::writeDescriptorSet(descriptorSets[slot], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &instances[slot].descriptor),
+            vks::initializers::writeDescriptorSet(descriptorSets[slot], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &counter.descriptor),
+            vks::initializers::writeDescriptorSet(descriptorSets[slot], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &indirectDraws[slot].descriptor)
+        };
+        vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+        VkCommandBuffer cmdBuffer = commandBuffers[slot];
+        VkCommandBufferBeginInfo cmdBufInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+        cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        VK_CHECK(vkBeginCommandBuffer(cmdBuffer, &cmdBufInfo));
+        const uint32_t timing = stepIndex % timingSlots;
+        if (queryPool != VK_NULL_HANDLE) {
+            vkCmdResetQueryPool(cmdBuffer, queryPool, 4 * timing, 2);
+            vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 4 * timing);
+        }
+        if (stepIndex < stepSlots) {
+            // Only the instance count changes from step to step, simulate.comp writes it
+            VkDrawIndexedIndirectCommand command = { indexCount, 0, 0, 0, 0 };
+            vkCmdUpdateBuffer(cmdBuffer, indirectDraws[slot].buffer, 0, sizeof(command), &command);
+        }
+
+        // Submission order alone doesn't make the writes of earlier steps visible, and every operation below depends on the one before
+        allWritesBarrier(cmdBuffer);
+        if (grownFrom.buffer) {
+            VkBufferCopy region = { 0, 0, (VkDeviceSize)grownCount * sizeof(GpuBunny) };
+            vkCmdCopyBuffer(cmdBuffer, grownFrom.buffer, state.buffer, 1, &region);
+            allWritesBarrier(cmdBuffer);
+        }
+        vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSets[slot], 0, nullptr);
+        // Spawns and removals in the order they were requested
+        for (auto& op : ops) {
+            if (op.type == SpawnOp::truncate) {
+                vkCmdFillBuffer(cmdBuffer, counter.buffer, 0, sizeof(uint32_t), op.params.first);
+            } else {
+                vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, spawnPipeline);
+                vkCmdPushConstants(cmdBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(SpawnParams), &op.params);
+                vkCmdDispatch(cmdBuffer, (op.params.count + workgroupSize - 1) / workgroupSize, 1, 1);
+            }
+            allWritesBarrier(cmdBuffer);
+        }
+        ops.clear();
+
+        // The count is read from device memory, the dispatch covers the population the spawns above add up to
+        vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+        const StepParams stepParams = { simulation, reversed ? capacity : 0 };
+        vkCmdPushConstants(cmdBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(StepParams), &stepParams);
+        vkCmdDispatch(cmdBuffer, (count + workgroupSize - 1) / workgroupSize, 1, 1);
+
+        if (queryPool != VK_NULL_HANDLE) {
+            vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 4 * timing + 1);
+        }
+        VK_CHECK(vkEndCommandBuffer(cmdBuffer));
+
+        // The frame that last drew this slot has to be done with the instances before they are overwritten
+        compute->waitFor(*frame, slotFrameValues[slot], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+        VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &cmdBuffer;
+        const uint64_t value = compute->submit(submitInfo);
+
+        if (grownFrom.buffer) {
+            retire(grownFrom, value, 0);
+            grownFrom = vks::Buffer();
+        }
+        slotComputeValues[slot] = value;
+        slotCounts[slot] = count;
+        slotReversedFirst[slot] = stepParams.reversedFirst;
+        latestSlot = slot;
+        computeSteps[timing] = stepIndex;
+        stepIndex++;
+    }
+
+    // Whether a step has produced instances to draw
+    bool drawable() const { return stepIndex > 0 && count > 0 && slotCounts[latestSlot] > 0; }
+    VkBuffer latestInstances() const { return instances[latestSlot].buffer; }
+    // VkDrawIndexedIndirectCommand with the bunny count of the latest step
+    VkBuffer latestIndirectDraw() const { return indirectDraws[latestSlot].buffer; }
+    uint32_t latestCount() const { return slotCounts[latestSlot]; }
+    // Offset of the instances of the latest step in reverse order, 0 if it didn't write them
+    VkDeviceSize latestReversedOffset() const { return (VkDeviceSize)slotReversedFirst[latestSlot] * instanceStride; }
+
+    // Bracket the commands of a frame that draws latestInstances()
+    void beginFrame(VkCommandBuffer cmdBuffer)
+    {
+        if (queryPool != VK_NULL_HANDLE && drawable()) {
+            const uint32_t timing = (stepIndex - 1) % timingSlots;
+            vkCmdResetQueryPool(cmdBuffer, queryPool, 4 * timing + 2, 2);
+            vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 4 * timing + 2);
+        }
+    }
+
+    void endFrame(VkCommandBuffer cmdBuffer)
+    {
+        if (queryPool != VK_NULL_HANDLE && drawable()) {
+            vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 4 * ((stepIndex - 1) % timingSlots) + 3);
+        }
+    }
+
+    // Makes the next frame submission wait for the step it draws, only its indirect draw and vertex input have to wait
+    void waitForLatest()
+    {
+        if (drawable()) {
+            frame->waitFor(*compute, slotComputeValues[latestSlot], VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+        }
+    }
+
+    // The frame with the given timeline value drew latestInstances()
+    void drawn(uint64_t frameValue)
+    {
+        if (drawable()) {
+            slotFrameValues[latestSlot] = frameValue;
+            drawnSteps[(stepIndex - 1) % timingSlots] = stepIndex - 1;
+        }
+    }
+
+    // Steps run on a queue of their own family, else they share the graphics queue
+    bool async() const { return queueFamilies.size() > 1; }
+    bool timed() const { return queryPool != VK_NULL_HANDLE; }
+    // Smoothed GPU time of a step in milliseconds
+    double stepMs() const { return stepTimeMs; }
+    // Smoothed share of a step that ran while the graphics queue drew the previous one
+    double overlap() const { return overlapShare; }
+
+private:
+    // Recorded into the next step
+    struct SpawnOp {
+        enum Type { truncate, spawn } type;
+        // truncate: params.first is the new count
+        SpawnParams params;
+    };
+    // Replaced buffers, destroyed once the steps and frames that used them are done
+    struct RetiredBuffer {
+        vks::Buffer buffer;
+        uint64_t computeValue;
+        uint64_t frameValue;
+    };
+
+    vks::VulkanDevice* vdevice = nullptr;
+    VkDevice device = VK_NULL_HANDLE;
+    vks::TimelineSemaphore* compute = nullptr;
+    vks::TimelineSemaphore* frame = nullptr;
+    std::vector<uint32_t> queueFamilies;
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    std::array<VkCommandBuffer, stepSlots> commandBuffers = {};
+    VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    std::array<VkDescriptorSet, stepSlots> descriptorSets = {};
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkPipeline spawnPipeline = VK_NULL_HANDLE;
+
+    uint32_t capacity = 0;
+    vks::Buffer state;
+    // State buffer before the population outgrew it, copied into the new one by the next step
+    vks::Buffer grownFrom;
+    uint32_t grownCount = 0;
+    // Bunny count, bumped atomically by spawn.comp
+    vks::Buffer counter;
+    std::array<vks::Buffer, stepSlots> instances;
+    std::array<vks::Buffer, stepSlots> indirectDraws;
+    // Indices of the sprite mesh drawn per bunny
+    uint32_t indexCount = 6;
+    std::vector<SpawnOp> ops;
+    std::vector<RetiredBuffer> retired;
+    uint32_t respawnCursor = 0;
+
+    uint32_t stepIndex = 0;
+    uint32_t latestSlot = 0;
+    // Per slot: compute timeline value of the last step that wrote it, frame timeline value of the last frame that drew it
+    std::array<uint64_t, stepSlots> slotComputeValues = {};
+    std::array<uint64_t, stepSlots> slotFrameValues = {};
+    std::array<uint32_t, stepSlots> slotCounts = {};
+    std::array<uint32_t, stepSlots> slotReversedFirst = {};
+
+    VkQueryPool queryPool = VK_NULL_HANDLE;
+    uint64_t timestampMask = 0;
+    float timestampPeriod = 0.f;
+    // Step whose compute and frame timestamps a timing slot holds
+    std::array<uint32_t, timingSlots> computeSteps = {};
+    std::array<uint32_t, timingSlots> drawnSteps = {};
+    double stepTimeMs = 0.0;
+    double overlapShare = 0.0;
+
+    void reserve(uint32_t n)
+    {
+        if (n <= capacity) {
+            return;
+        }
+        const uint32_t simulated = (stepIndex > 0) ? slotCounts[latestSlot] : 0;
+        capacity = std::max(std::max(n, capacity * 2), (uint32_t)minCapacity);
+        if (grownFrom.buffer) {
+            // Grown twice without a step in between, the state is still in the buffer the first growth replaced
+            state.destroy();
+        }
+        else if (state.buffer) {
+            grownFrom = state;
+            grownCount = simulated;
+        }
+        state = vks::Buffer();
+        state.create(vdevice, vks::BufferType::device, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, (VkDeviceSize)capacity * sizeof(GpuBunny));
+        // Every step rewrites all instances of its slot, so nothing needs to be copied. The second half holds them in reverse order.
+        for (uint32_t slot = 0; slot < stepSlots; slot++) {
+            if (instances[slot].buffer) {
+                retire(instances[slot], slotComputeValues[slot], slotFrameValues[slot]);
+            }
+            instances[slot] = vks::Buffer();
+            instances[slot].create(vdevice, vks::BufferType::device, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                (VkDeviceSize)capacity * 2 * instanceStride, false, queueFamilies);
+        }
+    }
+
+    void addSpawn(uint32_t first, uint32_t n, uint32_t serial, uint32_t spriteFrame, const SpriteSet& sprites)
+    {
+        if (n == 0) {
+            return;
+        }
+        SpawnOp op = { SpawnOp::spawn, { first, n, serial, spriteFrame, sprites.choices, sprites.stride, sprites.count } };
+        ops.push_back(op);
+    }
+
+    void retire(const vks::Buffer& buffer, uint64_t computeValue, uint64_t frameValue)
+    {
+        RetiredBuffer retiredBuffer = { buffer, computeValue, frameValue };
+        retired.push_back(retiredBuffer);
+    }
+
+    void releaseRetired()
+    {
+        for (size_t i = 0; i < retired.size();) {
+            if (compute->reached(retired[i].computeValue) && frame->reached(retired[i].frameValue)) {
+                retired[i].buffer.destroy();
+                retired[i] = retired.back();
+                retired.pop_back();
+            } else {
+                i++;
+            }
+        }
+    }
+
+    // Compute and transfer writes before the barrier are visible to compute and transfer commands after it
+    static void allWritesBarrier(VkCommandBuffer cmdBuffer)
+    {
+        const VkPipelineStageFlags stages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+        VkMemoryBarrier barrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(cmdBuffer, stages, stages, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+
+    // Compares step N + 1 with the frame that drew step N. Called before step N + 4 is recorded: step N + 1 is done, the
+    // frame most likely too, and neither timing slot has been reset for a newer step yet.
+    void readTimestamps()
+    {
+        if (queryPool == VK_NULL_HANDLE || stepIndex < timingSlots) {
+            return;
+        }
+        const uint32_t drawnStep = stepIndex - timingSlots;
+        const uint32_t frameTiming = drawnStep % timingSlots;
+        const uint32_t stepTiming = (drawnStep + 1) % timingSlots;
+        if (drawnSteps[frameTiming] != drawnStep || computeSteps[stepTiming] != drawnStep + 1) {
+            return;
+        }
+        uint64_t stepTimes[2];
+        uint64_t frameTimes[2];
+        const VkQueryResultFlags flags = VK_QUERY_RESULT_64_BIT;
+        if (vkGetQueryPoolResults(device, queryPool, 4 * stepTiming, 2, sizeof(stepTimes), stepTimes, sizeof(uint64_t), flags) != VK_SUCCESS ||
+            vkGetQueryPoolResults(device, queryPool, 4 * frameTiming + 2, 2, sizeof(frameTimes), frameTimes, sizeof(uint64_t), flags) != VK_SUCCESS) {
+            return;
+        }
+        for (uint32_t i = 0; i < 2; i++) {
+            stepTimes[i] &= timestampMask;
+            frameTimes[i] &= timestampMask;
+        }
+        // Skips samples across a counter wrap
+        if (stepTimes[1] <= stepTimes[0] || frameTimes[1] < frameTimes[0]) {
+            return;
+        }
+        const double stepTicks = (double)(stepTimes[1] - stepTimes[0]);
+        const uint64_t overlapBegin = std::max(stepTimes[0], frameTimes[0]);
+        const uint64_t overlapEnd = std::min(stepTimes[1], frameTimes[1]);
+        const double overlapTicks = (overlapEnd > overlapBegin) ? (double)(overlapEnd - overlapBegin) : 0.0;
+        const double ms = stepTicks * timestampPeriod * 1e-6;
+        const double share = overlapTicks / stepTicks;
+        const bool first = stepTimeMs == 0.0;
+        stepTimeMs = first ? ms : stepTimeMs + (ms - stepTimeMs) * 0.05;
+        overlapShare = first ? share : overlapShare + (share - overlapShare) * 0.05;
     }
 };
 
 class VulkanDemo : public VulkanFramework {
 public:
     vks::Texture2D texture;
+    // Tinted copies of the bunny texture (array or bindless sheet mode) or the atlas pages (array)
+    vks::Texture2DArray sheetArray;
+    std::vector<vks::Texture2D> sheetTextures;
+    uint32_t sheetCount = 1;
+    std::string atlasDirectory;
+    uint32_t atlasPages = 0;
+    // Bunny texture, either a PNG or a baked .vkt file
+    std::string textureFile;
+    // Target of -bake, BC7 payloads are written in front of the RGBA8 fallback unless disabled
+    std::string bakeFile;
+    bool bakeBC7 = true;
+    // Decode and upload of the bunny texture in the background, sprites sample a placeholder until it is ready
+    bool streamTexture = false;
+    std::unique_ptr<vks::TextureStreamer> textureStreamer;
+    vks::TextureStreamer::Handle streamedTexture = 0;
+    bool streamedTextureBound = false;
+    std::chrono::high_resolution_clock::time_point streamStart;
+    // Sprite frames for sprite.vert, only read when drawing from an atlas
+    std::vector<SpriteFrame> spriteFrames;
+    vks::Buffer frameTableBuffer;
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT descriptorIndexingFeatures{};
 
     struct {
         VkPipelineVertexInputStateCreateInfo inputState;
@@ -122,13 +1111,29 @@ public:
     vks::Buffer vertexBuffer;
     vks::Buffer indexBuffer;
     vks::Buffer instanceBuffer;
-    vks::Buffer uniformBuffer;
-
-    struct {
-        glm::mat4 projection;
-    } uboVS;
-
-    VkPipeline spritePipeline;
+    // Vertex budget of the alpha-trimmed sprite meshes, 0 draws full quads
+    uint32_t meshBudget = 0;
+    // Vertices of every sprite mesh in the vertex buffer, shorter meshes repeat their last vertex, and indices of the triangle fan
+    uint32_t meshVertices = 4;
+    uint32_t meshIndexCount = 6;
+    // Mesh area relative to the frame rectangle: per-draw frames on average and the mesh shared by per-instance UVs
+    float meshCoverage[2] = { 1.f, 1.f };
+    bool meshTrimmed = false;
+
+    // Maps pixel coordinates to clip space: clip = position * scale + translate
+    struct PushConstBlock {
+        glm::vec2 scale;
+        glm::vec2 translate;
+        // Texture rectangles (offset, size) of the bunny frames, used with per-instance UVs
+        glm::vec4 frames[frameCount];
+        // Depth of the first instance of a draw and the step between instances, pushed per draw by the depth tested modes
+        glm::vec2 depth;
+    } pushConstBlock;
+
+    ShaderVariant variant;
+    // Created on first use, keyed by ShaderVariant::key() and the SpritePass
+    std::map<uint32_t, VkPipeline> spritePipelines;
+    std::array<VkPipelineShaderStageCreateInfo, 2> spriteShaderStages;
     VkPipelineLayout pipelineLayout;
     VkDescriptorSet descriptorSet;
     VkDescriptorSetLayout descriptorSetLayout;
@@ -138,60 +1143,450 @@ public:
     {
         title = "Bunny Mark";
         settings.overlay = true;
+        textureFile = getAssetPath() + "textures/bunnys.png";
+
+        char* numConvPtr;
+        for (size_t i = 0; i < args.size(); i++) {
+            if ((args[i] == std::string("-churn")) && (i + 1 < args.size())) {
+                // Percentage of the population despawned and respawned every frame
+                float rate = strtof(args[i + 1], &numConvPtr);
+                if (numConvPtr != args[i + 1]) {
+                    churnRate = std::max(0.f, std::min(rate, 100.f));
+                }
+            }
+            if ((args[i] == std::string("-bunnies")) && (i + 1 < args.size())) {
+                // Initial population spawned at startup, zero and negative counts are ignored
+                long n = strtol(args[i + 1], &numConvPtr, 10);
+                if (numConvPtr != args[i + 1] && n > 0) {
+                    startupBunnies = (uint32_t)n;
+                }
+            }
+            if ((args[i] == std::string("-addcount")) && (i + 1 < args.size())) {
+                long n = strtol(args[i + 1], &numConvPtr, 10);
+                if (numConvPtr != args[i + 1] && n > 0) {
+                    bunniesEachTime = (uint32_t)n;
+                }
+            }
+            if ((args[i] == std::string("-addinterval")) && (i + 1 < args.size())) {
+                // in seconds
+                float t = strtof(args[i + 1], &numConvPtr);
+                if (numConvPtr != args[i + 1] && t > 0.f) {
+                    bunniesAddingThreshold = t;
+                }
+            }
+            if ((args[i] == std::string("-spawnthreads")) && (i + 1 < args.size())) {
+                // Total threads used for spawning including the main thread, 0 = all hardware threads, 1 = serial
+                long n = strtol(args[i + 1], &numConvPtr, 10);
+                if (numConvPtr != args[i + 1] && n >= 0) {
+                    spawnThreads = (uint32_t)n;
+                }
+            }
+            if ((args[i] == std::string("-animate")) && (i + 1 < args.size())) {
+                // Comma separated list of per-frame animations: rotate, scale
+                simulation.rotate = strstr(args[i + 1], "rotate") != nullptr;
+                simulation.scale = strstr(args[i + 1], "scale") != nullptr;
+            }
+            if (args[i] == std::string("-nogravity")) {
+                simulation.gravity = false;
+            }
+            if (args[i] == std::string("-nokick")) {
+                // No random extra speed when bouncing off the floor
+                simulation.kick = false;
+            }
+            if ((args[i] == std::string("-restitution")) && (i + 1 < args.size())) {
+                // Share of the vertical speed kept on floor bounces, 1 = elastic
+                float r = strtof(args[i + 1], &numConvPtr);
+                if (numConvPtr != args[i + 1]) {
+                    restitution = std::max(0.f, std::min(r, 1.f));
+                    simulation.restitution = restitution < 1.f;
+                }
+            }
+            if ((args[i] == std::string("-simdwidth")) && (i + 1 < args.size())) {
+                // Lanes per simulation step: 1 (scalar), 4 (SSE2/NEON) or 8 (AVX2), capped by the instruction sets of the build
+                uint32_t n = strtol(args[i + 1], &numConvPtr, 10);
+                if (numConvPtr != args[i + 1]) {
+                    simulation.simdWidth = n;
+                }
+            }
+            if ((args[i] == std::string("-simulation")) && (i + 1 < args.size())) {
+                // cpu: SIMD kernels (default), gpu: compute shader on the async compute queue overlapping the previous frame
+                gpuSimulation = args[i + 1] == std::string("gpu");
+            }
+            if ((args[i] == std::string("-transform")) && (i + 1 < args.size())) {
+                // cpu: matrices are built on the CPU and uploaded, gpu: angle and scale are uploaded, sprite.vert builds the matrix
+                variant.transform = (args[i + 1] == std::string("gpu")) ? TransformMode::angle : TransformMode::matrix;
+            }
+            if ((args[i] == std::string("-instances")) && (i + 1 < args.size())) {
+                // full: 32 bit floats, quantized: 16 bit snorm
+                variant.instanceFormat = (args[i + 1] == std::string("quantized")) ? InstanceFormat::quantized : InstanceFormat::full;
+            }
+            if ((args[i] == std::string("-uv")) && (i + 1 < args.size())) {
+                // draw: texture frame selected by vertex buffer offset per draw, instance: frame index per instance
+                variant.uvSource = (args[i + 1] == std::string("instance")) ? UvSource::perInstance : UvSource::perDraw;
+            }
+            if ((args[i] == std::string("-alpha")) && (i + 1 < args.size())) {
+                // blend: alpha blending, discard: alpha test without blending, depth: alpha test with early depth rejection,
+                // depthblend: depth followed by blending the soft edges
+                if (args[i + 1] == std::string("discard")) {
+                    variant.alphaMode = AlphaMode::discard;
+                }
+                else if (args[i + 1] == std::string("depth")) {
+                    variant.alphaMode = AlphaMode::depth;
+                }
+                else if (args[i + 1] == std::string("depthblend")) {
+                    variant.alphaMode = AlphaMode::depthBlend;
+                }
+                else {
+                    variant.alphaMode = AlphaMode::blend;
+                }
+            }
+            if ((args[i] == std::string("-spritemesh")) && (i + 1 < args.size())) {
+                // Vertex budget of polygons trimmed to the opaque texels of the bunny frames, 0 draws full quads
+                uint32_t n = strtol(args[i + 1], &numConvPtr, 10);
+                if (numConvPtr != args[i + 1]) {
+                    meshBudget = (n == 0) ? 0 : std::max(4u, std::min(n, maxMeshVertices));
+                }
+            }
+            if ((args[i] == std::string("-sheets")) && (i + 1 < args.size())) {
+                // Number of distinct sprite sheets, more than one are all drawn with a single draw per chunk
+                uint32_t n = strtol(args[i + 1], &numConvPtr, 10);
+                if (numConvPtr != args[i + 1]) {
+                    sheetCount = std::max(1u, std::min(n, maxSheets));
+                }
+            }
+            if ((args[i] == std::string("-sheetmode")) && (i + 1 < args.size())) {
+                // bindless: descriptor indexing (default, falls back to array when unsupported), array: one sampler2DArray
+                variant.sheetMode = (args[i + 1] == std::string("array")) ? SheetMode::array : SheetMode::bindless;
+            }
+            if ((args[i] == std::string("-atlas")) && (i + 1 < args.size())) {
+                // Directory of PNG files packed into an atlas at startup, every image is one sprite frame, or a baked atlas (.vkt)
+                atlasDirectory = args[i + 1];
+            }
+            if ((args[i] == std::string("-texture")) && (i + 1 < args.size())) {
+                // Bunny texture as PNG or baked .vkt file
+                textureFile = args[i + 1];
+            }
+            if (args[i] == std::string("-stream")) {
+                // Loads the bunny texture on worker threads and the transfer queue, only used when drawing from a single sheet
+                streamTexture = true;
+            }
+            if ((args[i] == std::string("-bake")) && (i + 1 < args.size())) {
+                // Writes the atlas (with -atlas) or the bunny texture to a baked .vkt file and uses it for this run
+                bakeFile = args[i + 1];
+            }
+            if ((args[i] == std::string("-bakeformat")) && (i + 1 < args.size())) {
+                // bc7: BC7 with RGBA8 fallback (default), rgba8: uncompressed only
+                bakeBC7 = args[i + 1] != std::string("rgba8");
+            }
+            if ((args[i] == std::string("-chunksize")) && (i + 1 < args.size())) {
+                // Chunk size in KiB, clamped to 64 KiB..2 MiB, zero and negative sizes are ignored
+                long kb = strtol(args[i + 1], &numConvPtr, 10);
+                if (numConvPtr != args[i + 1] && kb > 0) {
+                    const long minKb = (long)(vks::ChunkArena::minChunkSize / 1024), maxKb = (long)(vks::ChunkArena::maxChunkSize / 1024);
+                    bunnyArena.setChunkSize((size_t)std::max(minKb, std::min(kb, maxKb)) * 1024);
+                }
+            }
+        }
+        if (!bakeFile.empty()) {
+            bakeTexture();
+        }
+        if (!atlasDirectory.empty()) {
+            // Atlas pages are the layers of the sheet array texture
+            variant.spriteSource = SpriteSource::atlas;
+            variant.sheetMode = SheetMode::array;
+            variant.uvSource = UvSource::perInstance;
+            sheetCount = 1;
+        }
+        else if (sheetCount > 1) {
+            if (variant.sheetMode == SheetMode::single) {
+                variant.sheetMode = SheetMode::bindless;
+            }
+            // The sheet index travels with the frame index in the instance data
+            variant.uvSource = UvSource::perInstance;
+            if (variant.sheetMode == SheetMode::bindless) {
+                // Needed for vkGetPhysicalDeviceFeatures2 and passing feature structures to device creation
+                apiVersion = VK_API_VERSION_1_1;
+            }
+        }
+        else {
+            variant.sheetMode = SheetMode::single;
+        }
+        if (variant.sheetMode != SheetMode::single) {
+            // The sheets and atlas pages are loaded at startup and the bunny texture isn't sampled
+            streamTexture = false;
+        }
+        if (gpuSimulation) {
+            // simulate.comp writes instances in this layout, the queues are ordered with timelines
+            variant.instanceFormat = InstanceFormat::full;
+            variant.transform = TransformMode::angle;
+            variant.uvSource = UvSource::perInstance;
+            settings.timelineSemaphores = true;
+            if (settings.renderThread) {
+#if defined(VK_USE_PLATFORM_ANDROID_KHR)
+                LOGD("GPU simulation records on the main thread, render thread disabled");
+#else
+                std::cout << "GPU simulation records on the main thread, render thread disabled" << std::endl;
+#endif
+                settings.renderThread = false;
+            }
+        }
+        if (spawnThreads != 1) {
+            spawnPool.reset(new vks::ThreadPool(spawnThreads > 1 ? spawnThreads - 1 : 0));
+        }
+        if (settings.renderThread) {
+            instanceSlots = renderSlots;
+        }
     }
 
     ~VulkanDemo()
     {
-        vkDestroyPipeline(device, spritePipeline, nullptr);
+        for (auto& pipeline : spritePipelines) {
+            vkDestroyPipeline(device, pipeline.second, nullptr);
+        }
         vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
         vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+        for (VkFence fence : slotFences) {
+            vkDestroyFence(device, fence, nullptr);
+        }
 
         for (auto& batch : spriteBatches) {
-            batch.instanceBuffer.destroy();
+            for (BunnyChunk* chunk : batch.chunks) {
+                chunk->destroy();
+            }
         }
+        for (BunnyChunk* chunk : freeChunks) {
+            chunk->destroy();
+        }
+        bunnyArena.clear();
 
+        computeSimulation.reset();
+        textureStreamer.reset();
         texture.destroy();
+        if (variant.sheetMode == SheetMode::array) {
+            sheetArray.destroy();
+        }
+        for (auto& sheet : sheetTextures) {
+            sheet.destroy();
+        }
+        frameTableBuffer.destroy();
         vertexBuffer.destroy();
         indexBuffer.destroy();
         instanceBuffer.destroy();
-        uniformBuffer.destroy();
     }
 
-    void initBunny(Sprite& bunny) {
-        bunny.x = bunny.y = 0.f;
-        bunny.speedX = rrand() * 10;
-        bunny.speedY = rrand() * 10 - 5;
-        bunny.scale = rrand(0.5, 1.0);
-        bunny.rotation = rrand() - 0.5;
+    uint32_t bunnyCount = 0;
+    uint32_t startupBunnies = 0;
+    uint32_t bunniesEachTime = 5000;
+    float bunniesAddingThreshold = 0.1f; // in seconds
+    vks::ChunkArena bunnyArena;
+    // Emptied chunks are kept with their instance buffers for reuse, command buffers in flight may still reference them
+    std::vector<BunnyChunk*> freeChunks;
+    std::vector<SpriteBatch> spriteBatches;
+    // Simulation bounds, kept apart from width and height as a render thread resizes whenever it likes
+    glm::vec2 simulationExtent;
+    // With a render thread the simulation fills one instance buffer slot while the GPU reads the others
+    static const uint32_t renderSlots = 3;
+    uint32_t instanceSlots = 1;
+    uint32_t instanceSlot = 0;
+    // Render thread only: signaled once the GPU is done with every frame that read the slot, with timeline semaphores
+    // the frame timeline value of the last frame that read it instead
+    std::array<VkFence, renderSlots> slotFences = {};
+    std::array<uint64_t, renderSlots> slotValues = {};
+    uint32_t renderFrameIndex = 0;
+    // Input to submit latency of the last frame, handed back to the frame pacer on the main thread
+    double renderLatency = 0.0;
+    FrameSnapshot snapshot;
+    uint32_t currentTexId = 0;
+    float churnRate = 0.f;
+    float churnRemainder = 0.f;
+    SimulationFeatures simulation;
+    float restitution = 0.85f;
+    uint32_t simulationFrame = 0;
+    // Kernel throughput, averaged over one second
+    double simulationSeconds = 0.0;
+    uint64_t simulatedBunnies = 0;
+    float simulationTimer = 0.f;
+    float simulationThroughput = 0.f;
+    // Simulation on the compute queue instead of the CPU kernels, requested with -simulation gpu
+    bool gpuSimulation = false;
+    std::unique_ptr<ComputeSimulation> computeSimulation;
+
+    struct SpawnRange {
+        BunnyChunk* chunk;
+        uint32_t begin;
+        uint32_t end;
+        uint32_t serial;
+    };
+    std::vector<SpawnRange> spawnRanges;
+    uint32_t spawnSerial = 0;
+    uint32_t spawnThreads = 0;
+    std::unique_ptr<vks::ThreadPool> spawnPool;
+
+    BunnyChunk* acquireChunk(uint32_t frame) {
+        BunnyChunk* chunk;
+        if (freeChunks.empty()) {
+            chunk = BunnyChunk::create(bunnyArena, vulkanDevice, instanceSlots);
+        }
+        else {
+            chunk = freeChunks.back();
+            freeChunks.pop_back();
+        }
+        chunk->frame = frame;
+        chunk->instanceStride = instancePacking(variant).stride;
+        return chunk;
+    }
+    void releaseChunk(BunnyChunk* chunk) {
+        chunk->count = 0;
+        freeChunks.push_back(chunk);
+    }
+
+    void addBunnies(uint32_t amount) {
+        if (amount == 0) {
+            return;
+        }
+        if (computeSimulation) {
+            computeSimulation->spawn(amount, spawnSerial, currentTexId, spriteSet());
+            spawnSerial += amount;
+            bunnyCount += amount;
+            return;
+        }
+        // Consecutive additions with the same texture share a batch, so the draw order is unchanged
+        if (spriteBatches.empty() || spriteBatches.back().texId != currentTexId) {
+            spriteBatches.emplace_back(currentTexId);
+        }
+        SpriteBatch& batch = spriteBatches.back();
+        // Reserve all slots first, chunk creation talks to Vulkan and stays on this thread
+        spawnRanges.clear();
+        while (amount > 0) {
+            if (batch.chunks.empty() || batch.chunks.back()->full()) {
+                batch.chunks.push_back(acquireChunk(batch.texId));
+            }
+            BunnyChunk& chunk = *batch.chunks.back();
+            uint32_t n = std::min(amount, chunk.capacity - chunk.count);
+            for (uint32_t begin = chunk.count; begin < chunk.count + n; begin += spawnGrain) {
+                uint32_t end = std::min(begin + spawnGrain, chunk.count + n);
+                SpawnRange range = { &chunk, begin, end, spawnSerial + (begin - chunk.count) };
+                spawnRanges.push_back(range);
+            }
+            spawnSerial += n;
+            chunk.count += n;
+            batch.count += n;
+            bunnyCount += n;
+            amount -= n;
+        }
+        // Ranges never overlap, so they can be filled in parallel
+        std::vector<SpawnRange>& ranges = spawnRanges;
+        const InstancePacking& packing = instancePacking(variant);
+        const SpriteSet sprites = spriteSet();
+        auto spawnRange = [&ranges, &sprites, &packing](uint32_t r) {
+            ranges[r].chunk->spawn(ranges[r].begin, ranges[r].end, ranges[r].serial, sprites, packing);
+        };
+        if (spawnPool && ranges.size() > 1) {
+            spawnPool->parallelFor((uint32_t)ranges.size(), spawnRange);
+        } else {
+            for (uint32_t r = 0; r < ranges.size(); ++r) {
+                spawnRange(r);
+            }
+        }
+        invalidateCommandBuffers();
+    }
+
+    // Atlas bunnies pick any of its frames, sheet bunnies keep the batch frame on a random sheet
+    SpriteSet spriteSet() const {
+        SpriteSet sprites;
+        if (variant.spriteSource == SpriteSource::atlas) {
+            sprites.choices = (uint32_t)spriteFrames.size();
+            sprites.stride = 1;
+            sprites.count = (uint32_t)spriteFrames.size();
+        }
+        else if (variant.sheetMode != SheetMode::single) {
+            sprites.choices = sheetCount;
+            sprites.stride = frameCount;
+            sprites.count = frameCount * sheetCount;
+        }
+        return sprites;
+    }
+
+    // Removes random bunnies of a batch, each hole is filled with the last bunny of the batch
+    void removeFromBatch(SpriteBatch& batch, uint32_t amount) {
+        if (amount == 0) {
+            return;
+        }
+        const uint32_t capacity = batch.chunks.front()->capacity;
+        for (uint32_t k = 0; k < amount; ++k) {
+            uint32_t index = rrandIndex(batch.count);
+            BunnyChunk& tail = *batch.chunks.back();
+            uint32_t last = tail.count - 1;
+            BunnyChunk& chunk = *batch.chunks[index / capacity];
+            uint32_t slot = index % capacity;
+            if (&chunk != &tail || slot != last) {
+                chunk.copyBunny(slot, tail, last);
+            }
+            tail.count--;
+            batch.count--;
+            if (tail.count == 0) {
+                releaseChunk(&tail);
+                batch.chunks.pop_back();
+            }
+        }
+        bunnyCount -= amount;
+    }
+
+    // Despawns bunnies from all batches in proportion to their size
+    void removeBunnies(uint32_t amount) {
+        amount = std::min(amount, bunnyCount);
+        if (amount == 0) {
+            return;
+        }
+        if (computeSimulation) {
+            computeSimulation->remove(amount);
+            bunnyCount -= amount;
+            return;
+        }
+        const uint32_t total = bunnyCount;
+        uint32_t remaining = amount;
+        for (auto& batch : spriteBatches) {
+            uint32_t n = std::min(remaining, (uint32_t)((uint64_t)amount * batch.count / total));
+            removeFromBatch(batch, n);
+            remaining -= n;
+        }
+        // Rounding leftovers come from the newest batches
+        for (size_t b = spriteBatches.size(); b-- > 0 && remaining > 0;) {
+            uint32_t n = std::min(remaining, spriteBatches[b].count);
+            removeFromBatch(spriteBatches[b], n);
+            remaining -= n;
+        }
+        spriteBatches.erase(std::remove_if(spriteBatches.begin(), spriteBatches.end(),
+            [](const SpriteBatch& batch) { return batch.count == 0; }), spriteBatches.end());
+        invalidateCommandBuffers();
     }
 
-    uint32_t bunnyCount = 0;
-    std::vector<SpriteBatch> spriteBatches;
-    uint32_t currentTexId = 0;
-    void addBunnies(int32_t amount) {
-        spriteBatches.emplace_back(currentTexId);
-        SpriteBatch& batch = spriteBatches.back();
-        std::vector<Sprite> sprs;
-        sprs.resize(amount);
-        for (int i = 0; i < amount; ++i) {
-            Sprite& bunny = sprs[i];
-            bunny.x = bunny.y = 0.f;
-            bunny.speedX = rrand() * 10;
-            bunny.speedY = rrand() * 10 - 5;
-            bunny.scale = rrand(0.5, 1.0);
-            bunny.rotation = rrand() - 0.5;
-        }
-        batch.initSprites(vulkanDevice, sprs);
-        bunnyCount += amount;
+    // Switches the shader variant, the instance data of every chunk is rewritten in the new layout
+    void setVariant(const ShaderVariant& newVariant) {
+        variant = newVariant;
+        const InstancePacking& packing = instancePacking(variant);
+        for (auto& batch : spriteBatches) {
+            for (BunnyChunk* chunk : batch.chunks) {
+                chunk->repack(packing);
+            }
+        }
         invalidateCommandBuffers();
     }
 
     float clickDownTime = -1.f;
+    float removeDownTime = -1.f;
     inline bool isClickDown() {
-#if defined(_WIN32)
+#if defined(_WIN32) || defined(VK_USE_PLATFORM_XCB_KHR)
         return mouseButtons.left;
 #elif defined(VK_USE_PLATFORM_ANDROID_KHR)
         return touchDown;
+#endif
+    }
+    inline bool isRemoveDown() {
+#if defined(_WIN32) || defined(VK_USE_PLATFORM_XCB_KHR)
+        return mouseButtons.right;
+#else
+        return false;
 #endif
     }
     void update(float deltaTime)
@@ -213,55 +1608,182 @@ public:
         else if (clickDownTime > 0) {
             clickDownTime = -1.0f;
             currentTexId++;
-            currentTexId %= 5;
+            currentTexId %= frameCount;
+        }
+
+        if (isRemoveDown()) {
+            if (removeDownTime < 0) {
+                removeDownTime = deltaTime;
+                removeBunnies(bunniesEachTime);
+            }
+            else {
+                removeDownTime += deltaTime;
+                if (removeDownTime > bunniesAddingThreshold) {
+                    removeBunnies(bunniesEachTime);
+                    removeDownTime -= bunniesAddingThreshold;
+                }
+            }
+        }
+        else {
+            removeDownTime = -1.0f;
+        }
+
+        // churn: replace a fixed share of the population every frame
+        if (churnRate > 0.f && bunnyCount > 0) {
+            churnRemainder += bunnyCount * churnRate * 0.01f;
+            uint32_t churned = (uint32_t)churnRemainder;
+            churnRemainder -= churned;
+            if (computeSimulation) {
+                // Overwritten in place, the state buffer has no random removal
+                computeSimulation->respawn(churned, spawnSerial, currentTexId, spriteSet());
+                spawnSerial += churned;
+            }
+            else {
+                removeBunnies(churned);
+                addBunnies(churned);
+            }
         }
 
         // update bunnies!
-        float maxX = width;
+        float maxX = simulationExtent.x;
         //float minX = 0;
-        float maxY = height;
+        float maxY = simulationExtent.y;
         //float minY = 0;
         float d = 60.f * deltaTime; // pixijs's bunnymark work at 60 fps
         float gravityd = gravity * d;
+        const InstancePacking& packing = instancePacking(variant);
+        SimulationParams params;
+        params.d = d;
+        params.gravity = gravityd;
+        params.maxX = maxX;
+        params.maxY = maxY;
+        params.restitution = restitution;
+        uint32_t frameSeed = hash32(simulationFrame++);
+        if (computeSimulation) {
+            if (bunnyCount > 0) {
+                params.kickSeed = frameSeed;
+                computeSimulation->step(params, variant.depthTested());
+            }
+            if (computeSimulation->stepMs() > 0.0) {
+                simulationThroughput = (float)(bunnyCount / computeSimulation->stepMs() * 1e-3);
+            }
+            framePacer.simulated();
+            return;
+        }
+        SimulateFn simulate = simulationKernel(simulation);
         for (auto& batch : spriteBatches) {
-            for (auto& bunny : batch.sprites) {
-                bunny.x += bunny.speedX * d;
-                bunny.y += bunny.speedY * d;
-                bunny.speedY += gravityd;
-
-                if (bunny.x > maxX) {
-                    bunny.speedX *= -1;
-                    bunny.x = maxX;
-                }
-                else if (bunny.x < 0) {
-                    bunny.speedX *= -1;
-                    bunny.x = 0;
-                }
-                if (bunny.y > maxY) {
-                    bunny.speedY *= -0.85f;
-                    bunny.y = maxY;
-                    if (rand() & 1) { // if (Math.rrand() > 0.5)
-                        bunny.speedY -= rrand() * 6;
-                    }
+            for (BunnyChunk* chunk : batch.chunks) {
+                params.kickSeed = frameSeed;
+                frameSeed += chunk->capacity;
+                auto tStart = std::chrono::high_resolution_clock::now();
+                simulate(*chunk, params);
+                simulationSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - tStart).count();
+                packing.packPositions(*chunk, 0, chunk->count);
+                if (simulation.rotate || simulation.scale) {
+                    packing.packTransforms(*chunk, 0, chunk->count);
                 }
-                else if (bunny.y < 0) {
-                    bunny.speedY = 0;
-                    bunny.y = 0;
-                }
-                bunny.updatePosition();
+                chunk->flush(instanceSlot);
             }
-            batch.flush();
         }
+        simulatedBunnies += bunnyCount;
+        simulationTimer += deltaTime;
+        if (simulationTimer > 1.f) {
+            simulationThroughput = simulationSeconds > 0.0 ? (float)(simulatedBunnies / simulationSeconds * 1e-6) : 0.f;
+            simulationSeconds = 0.0;
+            simulatedBunnies = 0;
+            simulationTimer = 0.f;
+        }
+        framePacer.simulated();
     }
 
     virtual void getEnabledFeatures()
     {
+        if (variant.sheetMode == SheetMode::bindless && !enableDescriptorIndexing()) {
+#if defined(VK_USE_PLATFORM_ANDROID_KHR)
+            LOGD("Descriptor indexing not supported, using a texture array for the sprite sheets");
+#else
+            std::cout << "Descriptor indexing not supported, using a texture array for the sprite sheets" << std::endl;
+#endif
+            variant.sheetMode = SheetMode::array;
+        }
+    }
+
+    // Enables the descriptor indexing subset needed by sprite_bindless.frag: an unsized sampler array indexed non-uniformly
+    bool enableDescriptorIndexing()
+    {
+        if (deviceProperties.apiVersion < VK_API_VERSION_1_1) {
+            return false;
+        }
+        uint32_t extCount = 0;
+        vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extCount, nullptr);
+        std::vector<VkExtensionProperties> extensions(extCount);
+        vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extCount, extensions.data());
+        bool supported = false;
+        for (auto& ext : extensions) {
+            supported |= strcmp(ext.extensionName, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) == 0;
+        }
+        if (!supported) {
+            return false;
+        }
+        VkPhysicalDeviceDescriptorIndexingFeaturesEXT supportedFeatures{};
+        supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+        VkPhysicalDeviceFeatures2 features2{};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features2.pNext = &supportedFeatures;
+        vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+        if (!supportedFeatures.runtimeDescriptorArray || !supportedFeatures.shaderSampledImageArrayNonUniformIndexing) {
+            return false;
+        }
+        descriptorIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+        descriptorIndexingFeatures.runtimeDescriptorArray = VK_TRUE;
+        descriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+        deviceCreatepNextChain = &descriptorIndexingFeatures;
+        enabledDeviceExtensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+        enabledDeviceExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+        return true;
+    }
+
+    // Copies the draws of the current simulation state, their instances are read from the given slot
+    void captureSnapshot(uint32_t slot)
+    {
+        snapshot.batches.clear();
+        snapshot.draws.clear();
+        if (computeSimulation) {
+            // All bunnies are in the instance buffer of the latest step, sprites are selected per instance
+            if (computeSimulation->drawable()) {
+                FrameSnapshot::Batch batch = { 0, 0, 1 };
+                FrameSnapshot::Draw draw = { computeSimulation->latestInstances(), 0, computeSimulation->latestCount(), computeSimulation->latestIndirectDraw(),
+                    computeSimulation->latestReversedOffset() };
+                snapshot.batches.push_back(batch);
+                snapshot.draws.push_back(draw);
+            }
+        }
+        for (auto& spriteBatch : spriteBatches) {
+            FrameSnapshot::Batch batch = { spriteBatch.texId, (uint32_t)snapshot.draws.size(), (uint32_t)spriteBatch.chunks.size() };
+            snapshot.batches.push_back(batch);
+            for (BunnyChunk* chunk : spriteBatch.chunks) {
+                FrameSnapshot::Draw draw = { chunk->instanceBuffer.buffer, chunk->slotOffset(slot), chunk->count, VK_NULL_HANDLE, 0 };
+                snapshot.draws.push_back(draw);
+            }
+        }
+        snapshot.variant = variant;
+        snapshot.descriptorSet = descriptorSet;
+        snapshot.slot = slot;
+        snapshot.inputTime = framePacer.simulatedInputTime();
     }
 
     void buildCommandBuffer(VkCommandBuffer drawCmdBuffer, VkFramebuffer frameBuffer)
     {
+        // The render thread records the snapshot published with the frame
+        if (!settings.renderThread) {
+            captureSnapshot(0);
+        }
+
         VkCommandBufferBeginInfo cmdBufInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
         VK_CHECK(vkBeginCommandBuffer(drawCmdBuffer, &cmdBufInfo));
+        if (computeSimulation) {
+            computeSimulation->beginFrame(drawCmdBuffer);
+        }
 
         VkClearValue clearValues[2];
         clearValues[0].color = { { 1.0f, 1.0f, 1.0f, 1.0f } };
@@ -283,67 +1805,234 @@ public:
         VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
         vkCmdSetScissor(drawCmdBuffer, 0, 1, &scissor);
 
-        vkCmdBindDescriptorSets(drawCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
-        vkCmdBindPipeline(drawCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, spritePipeline);
-
-        VkDeviceSize offsets[1];
-        for (auto& spriteBatch : spriteBatches) {
-            offsets[0] = sizeof(VertexData) * 4 * spriteBatch.texId;
-            vkCmdBindVertexBuffers(drawCmdBuffer, VERTEX_BUFFER_BIND_ID, 1, &vertexBuffer.buffer, offsets);
-
-            offsets[0] = 0;
-            vkCmdBindVertexBuffers(drawCmdBuffer, INSTANCE_BUFFER_BIND_ID, 1, &spriteBatch.instanceBuffer.buffer, offsets);
+        vkCmdBindDescriptorSets(drawCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &snapshot.descriptorSet, 0, NULL);
+        vkCmdBindPipeline(drawCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, getPipeline(snapshot.variant));
+        vkCmdPushConstants(drawCmdBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstBlock), &pushConstBlock);
 
-            vkCmdBindIndexBuffer(drawCmdBuffer, indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT16);
+        vkCmdBindIndexBuffer(drawCmdBuffer, indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT16);
 
-            vkCmdDrawIndexed(drawCmdBuffer, 6, spriteBatch.size(), 0, 0, 0);
+        if (snapshot.variant.depthTested()) {
+            // Opaque texels front to back, bunnies hidden behind them are rejected before shading
+            recordSpriteDraws(drawCmdBuffer, snapshot, true);
+            if (snapshot.variant.alphaMode == AlphaMode::depthBlend) {
+                vkCmdBindPipeline(drawCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, getPipeline(snapshot.variant, SpritePass::edges));
+                recordSpriteDraws(drawCmdBuffer, snapshot, false);
+            }
+        }
+        else {
+            recordSpriteDraws(drawCmdBuffer, snapshot, false);
         }
 
         drawUI(drawCmdBuffer);
 
         vkCmdEndRenderPass(drawCmdBuffer);
+        if (computeSimulation) {
+            computeSimulation->endFrame(drawCmdBuffer);
+        }
 
         VK_CHECK(vkEndCommandBuffer(drawCmdBuffer));
     }
 
+    // Later bunnies are drawn over earlier ones. The depth tested modes turn that order into depth, the last bunny is the
+    // nearest, so the draws can also be recorded front to back. Chunk draws are split into ranges of frontToBackRange
+    // instances recorded in reverse, the GPU simulation draws the reversed copy of its instances.
+    void recordSpriteDraws(VkCommandBuffer drawCmdBuffer, const FrameSnapshot& snapshot, bool frontToBack)
+    {
+        // Bunnies drawn before each draw
+        std::vector<uint32_t> firstBunny(snapshot.draws.size() + 1, 0);
+        for (size_t i = 0; i < snapshot.draws.size(); i++) {
+            firstBunny[i + 1] = firstBunny[i] + snapshot.draws[i].count;
+        }
+        const float depthStep = 1.f / (float)(firstBunny.back() + 1);
+
+        VkDeviceSize offsets[1];
+        const size_t batchCount = snapshot.batches.size();
+        for (size_t b = 0; b < batchCount; b++) {
+            const FrameSnapshot::Batch& batch = snapshot.batches[frontToBack ? batchCount - 1 - b : b];
+            // Per-instance UVs draw the mesh shared by all frames behind the per-frame meshes, all frames have the same size
+            const uint32_t mesh = (snapshot.variant.uvSource == UvSource::perDraw) ? batch.texId : frameCount;
+            offsets[0] = sizeof(VertexData) * meshVertices * mesh;
+            vkCmdBindVertexBuffers(drawCmdBuffer, VERTEX_BUFFER_BIND_ID, 1, &vertexBuffer.buffer, offsets);
+
+            for (uint32_t d = 0; d < batch.drawCount; d++) {
+                const uint32_t i = batch.firstDraw + (frontToBack ? batch.drawCount - 1 - d : d);
+                const FrameSnapshot::Draw& draw = snapshot.draws[i];
+                // gl_InstanceIndex counts from the first instance of the draw, so ranges of it keep the depth of the whole draw
+                glm::vec2 depth(1.f - (float)(firstBunny[i] + 1) * depthStep, depthStep);
+                VkDeviceSize offset = draw.offset;
+                if (frontToBack && draw.reversedOffset != 0) {
+                    // Reversed instance k is bunny count - 1 - k of the draw
+                    depth = glm::vec2(1.f - (float)(firstBunny[i] + draw.count) * depthStep, -depthStep);
+                    offset = draw.reversedOffset;
+                }
+                if (snapshot.variant.depthTested()) {
+                    vkCmdPushConstants(drawCmdBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, offsetof(PushConstBlock, depth), sizeof(depth), &depth);
+                }
+                vkCmdBindVertexBuffers(drawCmdBuffer, INSTANCE_BUFFER_BIND_ID, 1, &draw.buffer, &offset);
+                if (draw.indirectBuffer != VK_NULL_HANDLE) {
+                    vkCmdDrawIndexedIndirect(drawCmdBuffer, draw.indirectBuffer, 0, 1, 0);
+                } else if (frontToBack) {
+                    for (uint32_t end = draw.count; end > 0;) {
+                        const uint32_t first = (end > frontToBackRange) ? end - frontToBackRange : 0;
+                        vkCmdDrawIndexed(drawCmdBuffer, meshIndexCount, end - first, 0, 0, first);
+                        end = first;
+                    }
+                } else {
+                    vkCmdDrawIndexed(drawCmdBuffer, meshIndexCount, draw.count, 0, 0, 0);
+                }
+            }
+        }
+    }
+
     void draw()
     {
         VulkanFramework::prepareFrame();
 
-        VK_CHECK(vkWaitForFences(device, 1, &waitFences[currentBuffer], VK_TRUE, UINT64_MAX));
-        VK_CHECK(vkResetFences(device, 1, &waitFences[currentBuffer]));
+        framePacer.beginWait();
+        waitForDrawCmdBuffer(currentBuffer);
+        framePacer.endWait();
 
-        // Build command buffer if needed
-        if (!drawCmdBuffersValid[currentBuffer]) {
+        // Build command buffer if needed, the GPU simulation alternates between instance buffers and needs one every frame
+        if (!drawCmdBuffersValid[currentBuffer] || computeSimulation) {
             buildCommandBuffer(drawCmdBuffers[currentBuffer], frameBuffers[currentBuffer]);
             drawCmdBuffersValid[currentBuffer] = true;
         }
 
-        submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-        submitInfo.commandBufferCount = 1;
-        VK_CHECK(vkQueueSubmit(queue, 1, &submitInfo, waitFences[currentBuffer]));
+        if (computeSimulation) {
+            computeSimulation->waitForLatest();
+            computeSimulation->drawn(submitDrawCmdBuffer());
+        }
+        else {
+            submitDrawCmdBuffer();
+        }
+
+        VulkanFramework::submitFrame();
+    }
+
+    virtual void beginThreadedFrame()
+    {
+        VulkanFramework::prepareFrame();
+        waitForDrawCmdBuffer(currentBuffer);
+        // The simulation starts filling the next slot as soon as this frame is published
+        const uint32_t nextSlot = (renderFrameIndex + 1) % renderSlots;
+        if (settings.timelineSemaphores) {
+            timelines.frame.wait(slotValues[nextSlot]);
+        } else {
+            VK_CHECK(vkWaitForFences(device, 1, &slotFences[nextSlot], VK_TRUE, UINT64_MAX));
+            VK_CHECK(vkResetFences(device, 1, &slotFences[nextSlot]));
+        }
+    }
+
+    virtual void publishThreadedFrame()
+    {
+        // Streaming submits to the transfer queue, which may be the queue the render thread submits to
+        if (textureStreamer) {
+            updateStreaming();
+        }
+        captureSnapshot(instanceSlot);
+        instanceSlot = (instanceSlot + 1) % renderSlots;
+        simulationExtent = glm::vec2((float)width, (float)height);
+        if (renderLatency > 0.0) {
+            framePacer.addLatency(renderLatency);
+            renderLatency = 0.0;
+        }
+    }
+
+    virtual void endThreadedFrame()
+    {
+        // Chunk counts change every frame with churn, recording is cheap next to keeping one command buffer per slot and image
+        buildCommandBuffer(drawCmdBuffers[currentBuffer], frameBuffers[currentBuffer]);
+
+        const uint64_t frameValue = submitDrawCmdBuffer();
+        if (settings.timelineSemaphores) {
+            slotValues[snapshot.slot] = frameValue;
+        } else {
+            // A submission without batches signals its fence once all earlier work on the queue is done
+            VK_CHECK(vkQueueSubmit(queue, 0, nullptr, slotFences[snapshot.slot]));
+        }
+        renderLatency = std::chrono::duration<double, std::milli>(vks::FramePacer::Clock::now() - snapshot.inputTime).count();
+        renderFrameIndex++;
 
         VulkanFramework::submitFrame();
     }
 
 
-    std::vector<VertexData> generateQuadVertices(float tx, float ty, float tw, float th)
+    // Corners relative to the sprite center, texcoords in the texture or, for per-instance UVs, relative to the frame rectangle
+    void appendMeshVertices(std::vector<VertexData>& vertices, const vks::SpriteMesh& mesh, const glm::vec4& rect, float texw, float texh, bool frameRelative)
     {
-        float texw = (float)texture.width, texh = (float)texture.height;
-        float halfw = tw * 0.5f;
-        float halfh = th * 0.5f;
-        std::vector<VertexData> vertices = {
-            { { halfw, halfh, (tw + tx) / texw, (th + ty) / texh } },
-            { { -halfw, halfh, tx / texw, (th + ty) / texh } },
-            { { -halfw, -halfh, tx / texw, ty / texh } },
-            { { halfw, -halfh, (tw + tx) / texw, ty / texh } }
-        };
-        return vertices;
+        for (uint32_t i = 0; i < meshVertices; i++) {
+            const vks::SpriteMesh::Point& p = mesh.vertices[std::min(i, (uint32_t)mesh.vertices.size() - 1)];
+            VertexData vertex;
+            vertex.inPositionTexcoord.x = p.x - rect.z * 0.5f;
+            vertex.inPositionTexcoord.y = p.y - rect.w * 0.5f;
+            if (frameRelative) {
+                vertex.inPositionTexcoord.z = p.x / rect.z;
+                vertex.inPositionTexcoord.w = p.y / rect.w;
+            }
+            else {
+                vertex.inPositionTexcoord.z = (rect.x + p.x) / texw;
+                vertex.inPositionTexcoord.w = (rect.y + p.y) / texh;
+            }
+            vertices.push_back(vertex);
+        }
+    }
+
+    // Trims the meshes to the alpha of the bunny frames, the last mesh covers the opaque texels of every frame.
+    // Needs the decoded PNG, baked and streamed textures as well as atlas frames of different sizes keep their quads
+    bool trimSpriteMeshes(std::vector<vks::SpriteMesh>& meshes, const glm::vec4* frameRects)
+    {
+        const std::string alphaFile = (variant.sheetMode != SheetMode::single) ? getAssetPath() + "textures/bunnys.png" : textureFile;
+        if (variant.spriteSource == SpriteSource::atlas || textureStreamer || isBaked(alphaFile)) {
+            return false;
+        }
+        int w, h;
+        uint8_t* texData = texture.loadImageFile(alphaFile, &w, &h);
+        if (!texData) {
+            return false;
+        }
+        // All frames have the same size
+        const uint32_t frameWidth = (uint32_t)frameRects[0].z, frameHeight = (uint32_t)frameRects[0].w;
+        std::vector<uint8_t> shared;
+        for (uint32_t i = 0; i < frameCount; i++) {
+            const glm::vec4& rect = frameRects[i];
+            assert(rect.x + rect.z <= w && rect.y + rect.w <= h);
+            const uint8_t* frame = texData + ((size_t)rect.y * w + (size_t)rect.x) * 4;
+            std::vector<uint8_t> coverage;
+            vks::SpriteMesh::addCoverage(coverage, frame, w, frameWidth, frameHeight);
+            vks::SpriteMesh::addCoverage(shared, frame, w, frameWidth, frameHeight);
+            meshes[i].build(coverage, frameWidth, frameHeight, meshBudget);
+        }
+        meshes[frameCount].build(shared, frameWidth, frameHeight, meshBudget);
+        stbi_image_free(texData);
+        return true;
     }
-    void generateQuad()
+
+    void generateQuad(vks::TextureUploadBatch& uploads)
     {
-        std::string filename = getAssetPath() + "textures/bunnys.png";
-        texture.loadFromFile(filename, vulkanDevice, queue);
+        uint32_t texWidth, texHeight;
+        if (textureStreamer) {
+            // Only the header is read here, the frame rects need the texture size before the texture is ready
+            if (!vks::TextureStreamer::querySize(textureFile, texWidth, texHeight)) {
+                vks::tools::exitFatal("Could not load texture from " + textureFile, -1);
+            }
+            streamStart = std::chrono::high_resolution_clock::now();
+            streamedTexture = textureStreamer->request(textureFile, sheetMipLevels);
+            uint8_t placeholder[4] = { 192, 192, 192, 255 };
+            texture.fromBuffer(placeholder, sizeof(placeholder), VK_FORMAT_R8G8B8A8_UNORM, 1, 1, vulkanDevice, queue, 1, &uploads);
+        }
+        else {
+            if (isBaked(textureFile)) {
+                std::vector<vks::TextureAtlas::Frame> frames;
+                loadBaked(textureFile, texture, VK_IMAGE_VIEW_TYPE_2D, frames, uploads);
+            }
+            else {
+                // Bunnies are drawn at half to full size, the first mip level keeps minified sprites cache friendly
+                texture.loadFromFile(textureFile, vulkanDevice, queue, sheetMipLevels, &uploads);
+            }
+            texWidth = texture.width;
+            texHeight = texture.height;
+        }
+        const float texw = (float)texWidth, texh = (float)texHeight;
         /*
             bunny1 = new PIXI.Texture(wabbitTexture.baseTexture, new PIXI.math.Rectangle(2, 47, 26, 37));
             bunny2 = new PIXI.Texture(wabbitTexture.baseTexture, new PIXI.math.Rectangle(2, 86, 26, 37));
@@ -351,32 +2040,276 @@ public:
             bunny4 = new PIXI.Texture(wabbitTexture.baseTexture, new PIXI.math.Rectangle(2, 164, 26, 37));
             bunny5 = new PIXI.Texture(wabbitTexture.baseTexture, new PIXI.math.Rectangle(2, 2, 26, 37));
         */
+        const glm::vec4 frameRects[frameCount] = {
+            { 2, 47, 26, 37 },
+            { 2, 86, 26, 37 },
+            { 2, 125, 26, 37 },
+            { 2, 164, 26, 37 },
+            { 2, 2, 26, 37 }
+        };
+        // One mesh per frame for per-draw UVs, followed by the mesh shared by all frames for per-instance UVs
+        std::vector<vks::SpriteMesh> meshes(frameCount + 1);
+        meshTrimmed = (meshBudget > 0) && trimSpriteMeshes(meshes, frameRects);
+        meshVertices = 0;
+        for (uint32_t i = 0; i <= frameCount; i++) {
+            if (!meshTrimmed) {
+                meshes[i].rectangle((uint32_t)frameRects[0].z, (uint32_t)frameRects[0].w);
+            }
+            meshVertices = std::max(meshVertices, (uint32_t)meshes[i].vertices.size());
+        }
+        meshIndexCount = (meshVertices - 2) * 3;
+        const float frameArea = frameRects[0].z * frameRects[0].w;
+        meshCoverage[0] = 0.f;
+        for (uint32_t i = 0; i < frameCount; i++) {
+            meshCoverage[0] += meshes[i].area() / (frameArea * frameCount);
+        }
+        meshCoverage[1] = meshes[frameCount].area() / frameArea;
+        if (meshTrimmed) {
+#if defined(VK_USE_PLATFORM_ANDROID_KHR)
+            LOGD("Sprite meshes with %d vertices cover %.0f%% (per frame) and %.0f%% (shared) of the quads", meshVertices,
+                meshCoverage[0] * 100.f, meshCoverage[1] * 100.f);
+#else
+            std::cout << "Sprite meshes with " << meshVertices << " vertices cover " << (int)(meshCoverage[0] * 100.f) << "% (per frame) and "
+                << (int)(meshCoverage[1] * 100.f) << "% (shared) of the quads" << std::endl;
+#endif
+        }
+        else if (meshBudget > 0) {
+#if defined(VK_USE_PLATFORM_ANDROID_KHR)
+            LOGD("Sprite meshes need the bunny texture as PNG, drawing quads");
+#else
+            std::cout << "Sprite meshes need the bunny texture as PNG, drawing quads" << std::endl;
+#endif
+        }
+
         std::vector<VertexData> vertices;
-        std::vector<VertexData> quad;
-        quad = generateQuadVertices(2, 47, 26, 37); vertices.insert(vertices.end(), quad.begin(), quad.end());
-        quad = generateQuadVertices(2, 86, 26, 37); vertices.insert(vertices.end(), quad.begin(), quad.end());
-        quad = generateQuadVertices(2, 125, 26, 37); vertices.insert(vertices.end(), quad.begin(), quad.end());
-        quad = generateQuadVertices(2, 164, 26, 37); vertices.insert(vertices.end(), quad.begin(), quad.end());
-        quad = generateQuadVertices(2, 2, 26, 37); vertices.insert(vertices.end(), quad.begin(), quad.end());
+        spriteFrames.resize(frameCount);
+        for (uint32_t i = 0; i < frameCount; i++) {
+            const glm::vec4& rect = frameRects[i];
+            appendMeshVertices(vertices, meshes[i], rect, texw, texh, false);
+            pushConstBlock.frames[i] = rect / glm::vec4(texw, texh, texw, texh);
+            spriteFrames[i].rect = pushConstBlock.frames[i];
+            spriteFrames[i].size = glm::vec2(rect.z, rect.w);
+            spriteFrames[i].page = 0.f;
+            spriteFrames[i].padding = 0.f;
+        }
+        appendMeshVertices(vertices, meshes[frameCount], frameRects[0], texw, texh, true);
         vertexBuffer.create(vulkanDevice, vks::BufferType::device, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vertices.size() * sizeof(VertexData));
         vertexBuffer.uploadFromStaging(vertices.data(), vertices.size() * sizeof(VertexData), queue);
 
-        std::vector<uint16_t> indices = { 0, 1, 2, 2, 3, 0 };
+        // Triangle fan, repeated vertices only add degenerate triangles
+        std::vector<uint16_t> indices;
+        for (uint32_t i = 1; i + 1 < meshVertices; i++) {
+            indices.push_back(0);
+            indices.push_back((uint16_t)i);
+            indices.push_back((uint16_t)(i + 1));
+        }
         indexBuffer.create(vulkanDevice, vks::BufferType::device, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indices.size() * sizeof(uint16_t));
         indexBuffer.uploadFromStaging(indices.data(), indices.size() * sizeof(uint16_t), queue);
     }
 
-    void setupVertexDescriptions()
+    static bool isBaked(const std::string& filename)
+    {
+        return filename.size() > 4 && filename.compare(filename.size() - 4, 4, ".vkt") == 0;
+    }
+
+    // Uploads a baked texture straight from the mapped file, the device picks the payload format
+    void loadBaked(const std::string& filename, vks::Texture& target, VkImageViewType viewType, std::vector<vks::TextureAtlas::Frame>& frames,
+        vks::TextureUploadBatch& uploads)
+    {
+        VkFormat format = vks::baked::load(filename, target, viewType, frames, vulkanDevice, queue, &uploads);
+        if (format == VK_FORMAT_UNDEFINED) {
+            vks::tools::exitFatal("Could not load baked texture " + filename + ", the file is invalid or has no format supported by the device", -1);
+        }
+#if defined(VK_USE_PLATFORM_ANDROID_KHR)
+        LOGD("Loaded %s payload of %s", vks::baked::formatName(format), filename.c_str());
+#else
+        std::cout << "Loaded " << vks::baked::formatName(format) << " payload of " << filename << std::endl;
+#endif
+    }
+
+    // Packs every PNG of the atlas directory into atlas pages with mip chains, each image becomes one sprite frame
+    void buildAtlas(vks::TextureAtlas& atlas)
+    {
+        std::vector<std::string> files = vks::tools::listFiles(atlasDirectory, ".png");
+        if (files.empty()) {
+            vks::tools::exitFatal("No .png files found in " + atlasDirectory, -1);
+        }
+        if (files.size() > maxSprites) {
+            files.resize(maxSprites);
+        }
+        for (auto& file : files) {
+            int w, h;
+            uint8_t* texData = texture.loadImageFile(atlasDirectory + "/" + file, &w, &h);
+            if (!texData) {
+                continue;
+            }
+            atlas.add(texData, w, h);
+            stbi_image_free(texData);
+        }
+        if (!atlas.build()) {
+            vks::tools::exitFatal("Could not pack the images of " + atlasDirectory + " into an atlas", -1);
+        }
+    }
+
+    // Decodes and packs the startup texture once, so later runs only map the baked file. Runs before the device exists
+    void bakeTexture()
+    {
+        uint32_t texWidth, texHeight, layerCount = 1, mipLevels = 1;
+        std::vector<uint8_t> pixels;
+        std::vector<vks::TextureAtlas::Frame> frames;
+        if (!atlasDirectory.empty()) {
+            vks::TextureAtlas atlas(atlasPageSize);
+            buildAtlas(atlas);
+            texWidth = texHeight = atlas.getPageSize();
+            layerCount = atlas.getPageCount();
+            mipLevels = atlas.getMipLevels();
+            pixels = atlas.getPixels();
+            frames = atlas.getFrames();
+        }
+        else {
+            // The bunny frames are packed without borders, so the texture only keeps the levels its gaps allow
+            int w, h;
+            uint8_t* texData = texture.loadImageFile(textureFile, &w, &h);
+            if (!texData) {
+                vks::tools::exitFatal("Could not decode " + textureFile, -1);
+            }
+            texWidth = (uint32_t)w;
+            texHeight = (uint32_t)h;
+            mipLevels = std::min(sheetMipLevels, vks::Texture::mipLevelCount(texWidth, texHeight));
+            pixels = vks::Texture::buildMipChain(texData, texWidth, texHeight, mipLevels);
+            stbi_image_free(texData);
+        }
+
+        std::vector<vks::baked::PayloadData> payloads;
+        if (bakeBC7) {
+            vks::baked::PayloadData bc7;
+            bc7.format = VK_FORMAT_BC7_UNORM_BLOCK;
+            bc7.data = vks::baked::encodeBC7(pixels.data(), texWidth, texHeight, layerCount, mipLevels);
+            payloads.push_back(bc7);
+        }
+        vks::baked::PayloadData rgba8;
+        rgba8.format = VK_FORMAT_R8G8B8A8_UNORM;
+        rgba8.data.swap(pixels);
+        payloads.push_back(rgba8);
+        if (!vks::baked::write(bakeFile, texWidth, texHeight, layerCount, mipLevels, payloads, frames)) {
+            vks::tools::exitFatal("Could not write baked texture " + bakeFile, -1);
+        }
+
+        if (!atlasDirectory.empty()) {
+            atlasDirectory = bakeFile;
+        }
+        else {
+            textureFile = bakeFile;
+        }
+    }
+
+    // Atlas pages become the layers of the sheet array, built at startup or loaded from a baked atlas
+    void generateAtlas(vks::TextureUploadBatch& uploads)
+    {
+        const VkPhysicalDeviceLimits& limits = vulkanDevice->properties.limits;
+        std::vector<vks::TextureAtlas::Frame> frames;
+        if (isBaked(atlasDirectory)) {
+            loadBaked(atlasDirectory, sheetArray, VK_IMAGE_VIEW_TYPE_2D_ARRAY, frames, uploads);
+            if (frames.empty()) {
+                vks::tools::exitFatal(atlasDirectory + " holds no sprite frames", -1);
+            }
+            if (frames.size() > maxSprites) {
+                frames.resize(maxSprites);
+            }
+        }
+        else {
+            vks::TextureAtlas atlas(std::min(atlasPageSize, limits.maxImageDimension2D));
+            buildAtlas(atlas);
+            if (atlas.getPageCount() > limits.maxImageArrayLayers) {
+                vks::tools::exitFatal("Could not pack the images of " + atlasDirectory + " into an atlas", -1);
+            }
+            const std::vector<uint8_t>& pixels = atlas.getPixels();
+            sheetArray.fromBuffer((void*)pixels.data(), pixels.size(), VK_FORMAT_R8G8B8A8_UNORM, atlas.getPageSize(), atlas.getPageSize(),
+                atlas.getPageCount(), vulkanDevice, queue, atlas.getMipLevels(), &uploads);
+            frames = atlas.getFrames();
+        }
+        atlasPages = sheetArray.layerCount;
+
+        const float pageSize = (float)sheetArray.width;
+        spriteFrames.resize(frames.size());
+        for (size_t i = 0; i < frames.size(); i++) {
+            const vks::TextureAtlas::Frame& frame = frames[i];
+            spriteFrames[i].rect = glm::vec4((float)frame.x, (float)frame.y, (float)frame.width, (float)frame.height) / pageSize;
+            spriteFrames[i].size = glm::vec2((float)frame.width, (float)frame.height);
+            spriteFrames[i].page = (float)frame.page;
+            spriteFrames[i].padding = 0.f;
+        }
+    }
+
+    void prepareFrameTable()
+    {
+        VkDeviceSize size = spriteFrames.size() * sizeof(SpriteFrame);
+        frameTableBuffer.create(vulkanDevice, vks::BufferType::device, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, size);
+        frameTableBuffer.uploadFromStaging(spriteFrames.data(), size, queue);
+    }
+
+    // Stands in for distinct sprite sheets: tinted copies of the bunny texture, sheet 0 keeps the original colors
+    void generateSheets(vks::TextureUploadBatch& uploads)
+    {
+        const VkPhysicalDeviceLimits& limits = vulkanDevice->properties.limits;
+        if (variant.sheetMode == SheetMode::array) {
+            sheetCount = std::min(sheetCount, limits.maxImageArrayLayers);
+        }
+        else {
+            sheetCount = std::min(sheetCount, std::min(limits.maxPerStageDescriptorSampledImages, limits.maxPerStageDescriptorSamplers));
+            sheetCount = std::min(sheetCount, std::min(limits.maxDescriptorSetSampledImages, limits.maxDescriptorSetSamplers));
+        }
+
+        int w, h;
+        uint8_t* texData = texture.loadImageFile(getAssetPath() + "textures/bunnys.png", &w, &h);
+        assert(texData);
+        const size_t layerSize = (size_t)w * h * 4;
+        std::vector<uint8_t> pixels(layerSize * sheetCount);
+        for (uint32_t sheet = 0; sheet < sheetCount; sheet++) {
+            float tint[3] = { 1.f, 1.f, 1.f };
+            if (sheet > 0) {
+                for (uint32_t c = 0; c < 3; c++) {
+                    tint[c] = 0.3f + 0.7f * hrand(sheet * 3 + c);
+                }
+            }
+            uint8_t* dst = pixels.data() + sheet * layerSize;
+            for (size_t i = 0; i < layerSize; i += 4) {
+                dst[i + 0] = (uint8_t)(texData[i + 0] * tint[0]);
+                dst[i + 1] = (uint8_t)(texData[i + 1] * tint[1]);
+                dst[i + 2] = (uint8_t)(texData[i + 2] * tint[2]);
+                dst[i + 3] = texData[i + 3];
+            }
+        }
+        stbi_image_free(texData);
+
+        if (variant.sheetMode == SheetMode::array) {
+            const uint32_t mipLevels = std::min(sheetMipLevels, vks::Texture::mipLevelCount(w, h));
+            std::vector<uint8_t> layers;
+            for (uint32_t sheet = 0; sheet < sheetCount; sheet++) {
+                std::vector<uint8_t> chain = vks::Texture::buildMipChain(pixels.data() + sheet * layerSize, w, h, mipLevels);
+                layers.insert(layers.end(), chain.begin(), chain.end());
+            }
+            sheetArray.fromBuffer(layers.data(), layers.size(), VK_FORMAT_R8G8B8A8_UNORM, w, h, sheetCount, vulkanDevice, queue, mipLevels, &uploads);
+        }
+        else {
+            sheetTextures.resize(sheetCount);
+            for (uint32_t sheet = 0; sheet < sheetCount; sheet++) {
+                sheetTextures[sheet].fromBuffer(pixels.data() + sheet * layerSize, layerSize, VK_FORMAT_R8G8B8A8_UNORM, w, h, vulkanDevice, queue, sheetMipLevels, &uploads);
+            }
+        }
+    }
+
+    void setupVertexDescriptions(const InstancePacking& packing)
     {
         // Binding description
         vertices.bindingDescriptions = {
             vks::initializers::vertexInputBindingDescription(VERTEX_BUFFER_BIND_ID, sizeof(VertexData), VK_VERTEX_INPUT_RATE_VERTEX),
-            vks::initializers::vertexInputBindingDescription(INSTANCE_BUFFER_BIND_ID, sizeof(SpriteData), VK_VERTEX_INPUT_RATE_INSTANCE)
+            vks::initializers::vertexInputBindingDescription(INSTANCE_BUFFER_BIND_ID, packing.stride, VK_VERTEX_INPUT_RATE_INSTANCE)
         };
         vertices.attributeDescriptions = {
             vks::initializers::vertexInputAttributeDescription(VERTEX_BUFFER_BIND_ID, 0, VK_FORMAT_R32G32B32A32_SFLOAT, 0),
-            vks::initializers::vertexInputAttributeDescription(INSTANCE_BUFFER_BIND_ID, 1, VK_FORMAT_R32G32B32A32_SFLOAT, 0),
-            vks::initializers::vertexInputAttributeDescription(INSTANCE_BUFFER_BIND_ID, 2, VK_FORMAT_R32G32_SFLOAT, offsetof(SpriteData, inSpritePosition)),
+            vks::initializers::vertexInputAttributeDescription(INSTANCE_BUFFER_BIND_ID, 1, packing.formatA, 0),
+            vks::initializers::vertexInputAttributeDescription(INSTANCE_BUFFER_BIND_ID, 2, packing.formatB, packing.offsetB),
         };
 
         vertices.inputState = vks::initializers::pipelineVertexInputStateCreateInfo();
@@ -388,9 +2321,11 @@ public:
 
     void setupDescriptorPool()
     {
+        // Streaming adds the set that replaces the placeholder
+        const uint32_t setCount = textureStreamer ? 2 : 1;
         std::vector<VkDescriptorPoolSize> poolSizes = {
-            vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
-            vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1)
+            vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, ((variant.sheetMode == SheetMode::bindless) ? sheetCount : 1) * setCount),
+            vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, setCount)
         };
         VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(
             static_cast<uint32_t>(poolSizes.size()),
@@ -402,53 +2337,114 @@ public:
     void setupDescriptorSetLayout()
     {
         std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
-            // Binding 0 : Vertex shader uniform buffer
-            vks::initializers::descriptorSetLayoutBinding(
-                VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-                VK_SHADER_STAGE_VERTEX_BIT,
-                0),
-            // Binding 1 : sampler
+            // Binding 1 : sampler, one per sheet in bindless mode
             vks::initializers::descriptorSetLayoutBinding(
                 VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
                 VK_SHADER_STAGE_FRAGMENT_BIT,
-                1)
+                1,
+                (variant.sheetMode == SheetMode::bindless) ? sheetCount : 1),
+            // Binding 2 : sprite frame table
+            vks::initializers::descriptorSetLayoutBinding(
+                VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                VK_SHADER_STAGE_VERTEX_BIT,
+                2)
         };
 
         VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
         VK_CHECK(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
 
+        // Push constants for the pixel to clip space transform
+        VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_VERTEX_BIT, sizeof(PushConstBlock), 0);
         VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+        pPipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+        pPipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
         VK_CHECK(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
     }
 
     void setupDescriptorSet()
     {
-        VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
-        VK_CHECK(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
-
         // Setup a descriptor image info for the current texture to be used as a combined image sampler
-        VkDescriptorImageInfo textureDescriptor;
-        textureDescriptor.imageView = texture.view;
-        textureDescriptor.sampler = texture.sampler;
-        textureDescriptor.imageLayout = texture.imageLayout;
+        std::vector<VkDescriptorImageInfo> textureDescriptors(1, texture.descriptor);
+        if (variant.sheetMode == SheetMode::array) {
+            textureDescriptors[0] = sheetArray.descriptor;
+        }
+        else if (variant.sheetMode == SheetMode::bindless) {
+            textureDescriptors.resize(sheetCount);
+            for (uint32_t sheet = 0; sheet < sheetCount; sheet++) {
+                textureDescriptors[sheet] = sheetTextures[sheet].descriptor;
+            }
+        }
+        descriptorSet = allocateDescriptorSet(textureDescriptors);
+    }
+
+    VkDescriptorSet allocateDescriptorSet(std::vector<VkDescriptorImageInfo> textureDescriptors)
+    {
+        VkDescriptorSet set;
+        VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+        VK_CHECK(vkAllocateDescriptorSets(device, &allocInfo, &set));
         std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
-            // Binding 0 : Vertex shader uniform buffer
             vks::initializers::writeDescriptorSet(
-                descriptorSet,
-                VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-                0,
-                &uniformBuffer.descriptor),
-            vks::initializers::writeDescriptorSet(
-                descriptorSet,
+                set,
                 VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
                 1,
-                &textureDescriptor)
+                textureDescriptors.data(),
+                static_cast<uint32_t>(textureDescriptors.size())),
+            vks::initializers::writeDescriptorSet(
+                set,
+                VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                2,
+                &frameTableBuffer.descriptor)
         };
         vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+        return set;
+    }
+
+    // Swaps the placeholder for the streamed texture once its upload has landed, without waiting for the device
+    void updateStreaming()
+    {
+        textureStreamer->update();
+        if (streamedTextureBound) {
+            return;
+        }
+        vks::TextureStreamer::State state = textureStreamer->state(streamedTexture);
+        if (state == vks::TextureStreamer::State::failed) {
+            vks::tools::exitFatal("Could not stream texture from " + textureFile, -1);
+        }
+        if (state != vks::TextureStreamer::State::ready) {
+            return;
+        }
+        // Frames in flight keep using the placeholder set, so it is left untouched instead of being updated
+        descriptorSet = allocateDescriptorSet(std::vector<VkDescriptorImageInfo>(1, textureStreamer->texture(streamedTexture).descriptor));
+        streamedTextureBound = true;
+        invalidateCommandBuffers();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - streamStart).count();
+#if defined(VK_USE_PLATFORM_ANDROID_KHR)
+        LOGD("Streamed %s in %.2f ms", textureFile.c_str(), ms);
+#else
+        std::cout << "Streamed " << textureFile << " in " << ms << " ms" << std::endl;
+#endif
     }
 
     void preparePipelines()
     {
+        // Shader modules are shared by all variants, pipelines are created on first use
+        spriteShaderStages[0] = loadShader(getAssetPath() + "shaders/bunnymark/sprite.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+        const char* fragmentShaders[] = { "sprite.frag.spv", "sprite_array.frag.spv", "sprite_bindless.frag.spv" };
+        spriteShaderStages[1] = loadShader(getAssetPath() + "shaders/bunnymark/" + fragmentShaders[(uint32_t)variant.sheetMode], VK_SHADER_STAGE_FRAGMENT_BIT);
+        getPipeline(variant);
+        if (variant.alphaMode == AlphaMode::depthBlend) {
+            getPipeline(variant, SpritePass::edges);
+        }
+    }
+
+    VkPipeline getPipeline(const ShaderVariant& v, SpritePass pass = SpritePass::sprites)
+    {
+        const uint32_t key = v.key() | ((uint32_t)pass << 8);
+        auto it = spritePipelines.find(key);
+        if (it != spritePipelines.end()) {
+            return it->second;
+        }
+
         VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = vks::initializers::pipelineInputAssemblyStateCreateInfo(
             VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
 
@@ -456,7 +2452,9 @@ public:
             VK_POLYGON_MODE_FILL, VK_CULL_MODE_NONE, VK_FRONT_FACE_COUNTER_CLOCKWISE, 0);
 
         VkPipelineColorBlendAttachmentState blendAttachmentState = {};
-        blendAttachmentState.blendEnable = VK_TRUE;
+        // Alpha tested sprites are either fully opaque or discarded, the edges pass blends what the test dropped
+        const bool edges = (pass == SpritePass::edges);
+        blendAttachmentState.blendEnable = (v.alphaMode == AlphaMode::blend || edges) ? VK_TRUE : VK_FALSE;
         blendAttachmentState.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
         blendAttachmentState.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
         blendAttachmentState.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
@@ -465,8 +2463,10 @@ public:
 
         VkPipelineColorBlendStateCreateInfo colorBlendState = vks::initializers::pipelineColorBlendStateCreateInfo(1, &blendAttachmentState);
 
+        // Only the alpha tested pass writes depth, the edges pass stays behind the opaque texels of nearer bunnies
+        const VkBool32 depthTest = v.depthTested() ? VK_TRUE : VK_FALSE;
         VkPipelineDepthStencilStateCreateInfo depthStencilState = vks::initializers::pipelineDepthStencilStateCreateInfo(
-            VK_FALSE, VK_FALSE, VK_COMPARE_OP_LESS_OR_EQUAL);
+            depthTest, (depthTest && !edges) ? VK_TRUE : VK_FALSE, VK_COMPARE_OP_LESS);
 
         VkPipelineViewportStateCreateInfo viewportState = vks::initializers::pipelineViewportStateCreateInfo(1, 1, 0);
 
@@ -479,10 +2479,34 @@ public:
         VkPipelineDynamicStateCreateInfo dynamicState = vks::initializers::pipelineDynamicStateCreateInfo(
             dynamicStateEnables.data(), static_cast<uint32_t>(dynamicStateEnables.size()), 0);
 
-        // Load shaders
-        std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages;
-        shaderStages[0] = loadShader(getAssetPath() + "shaders/bunnymark/sprite.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
-        shaderStages[1] = loadShader(getAssetPath() + "shaders/bunnymark/sprite.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+        setupVertexDescriptions(instancePacking(v));
+
+        // Specialization constants select the variant, both stages share the same data and ignore the constants they don't declare
+        struct SpecializationData {
+            int32_t instanceFormat;
+            int32_t transformMode;
+            int32_t uvSource;
+            int32_t alphaMode;
+            int32_t sheetMode;
+            int32_t spriteSource;
+        } specializationData = { (int32_t)v.instanceFormat, (int32_t)v.transform, (int32_t)v.uvSource, 0, (int32_t)v.sheetMode,
+            (int32_t)v.spriteSource };
+        // sprite.frag only knows blending, the alpha test and the edges left over by it
+        specializationData.alphaMode = edges ? 2 : (v.alphaMode == AlphaMode::blend) ? 0 : 1;
+        std::array<VkSpecializationMapEntry, 6> specializationMapEntries = {
+            vks::initializers::specializationMapEntry(0, offsetof(SpecializationData, instanceFormat), sizeof(int32_t)),
+            vks::initializers::specializationMapEntry(1, offsetof(SpecializationData, transformMode), sizeof(int32_t)),
+            vks::initializers::specializationMapEntry(2, offsetof(SpecializationData, uvSource), sizeof(int32_t)),
+            vks::initializers::specializationMapEntry(3, offsetof(SpecializationData, alphaMode), sizeof(int32_t)),
+            vks::initializers::specializationMapEntry(4, offsetof(SpecializationData, sheetMode), sizeof(int32_t)),
+            vks::initializers::specializationMapEntry(5, offsetof(SpecializationData, spriteSource), sizeof(int32_t))
+        };
+        VkSpecializationInfo specializationInfo = vks::initializers::specializationInfo(
+            static_cast<uint32_t>(specializationMapEntries.size()), specializationMapEntries.data(), sizeof(specializationData), &specializationData);
+
+        std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages = spriteShaderStages;
+        shaderStages[0].pSpecializationInfo = &specializationInfo;
+        shaderStages[1].pSpecializationInfo = &specializationInfo;
 
         VkGraphicsPipelineCreateInfo pipelineCreateInfo = vks::initializers::pipelineCreateInfo(
             pipelineLayout, renderPass, 0);
@@ -498,49 +2522,141 @@ public:
         pipelineCreateInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
         pipelineCreateInfo.pStages = shaderStages.data();
 
-        VK_CHECK(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &spritePipeline));
+        VkPipeline pipeline;
+        VK_CHECK(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipeline));
+        spritePipelines[key] = pipeline;
+        return pipeline;
     }
 
-    // Prepare and initialize uniform buffer containing shader uniforms
-    void prepareUniformBuffers()
+    // Orthographic pixel to clip space mapping, (0, 0) maps to (-1, -1) and (width, height) to (1, 1)
+    void updatePushConstants()
     {
-        uniformBuffer.create(vulkanDevice, vks::BufferType::device, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, sizeof(uboVS));
-
-        float fov = 90;
-        float eyed = height * 0.5f / std::tan(glm::radians(fov) * 0.5f);
-        glm::vec3 eye = { 0.0f, 0.0f, -eyed };
-        glm::mat4 projection = glm::perspective(glm::radians(fov), (float)width / -(float)height, 0.1f, 1000.0f);
-        glm::mat4 view = glm::lookAt(eye, glm::vec3(0, 0, 0), glm::vec3(0, 1.0, 0));
-        view = glm::translate(view, glm::vec3(-(float)width / 2, -(float)height / 2, 0));
-
-        uboVS.projection = projection * view;
-
-        uniformBuffer.uploadFromStaging(&uboVS, sizeof(uboVS), queue);
+        pushConstBlock.scale = glm::vec2(2.0f / (float)width, 2.0f / (float)height);
+        pushConstBlock.translate = glm::vec2(-1.0f);
+        pushConstBlock.depth = glm::vec2(0.0f);
     }
 
     void prepare()
     {
         VulkanFramework::prepare();
-        generateQuad();
-        setupVertexDescriptions();
-        prepareUniformBuffers();
+        if (streamTexture) {
+            textureStreamer.reset(new vks::TextureStreamer(vulkanDevice, transferQueue));
+        }
+        // Every startup texture is recorded into one command buffer and uploaded with a single submit
+        vks::TextureUploadBatch textureUploads(vulkanDevice, queue);
+        generateQuad(textureUploads);
+        if (variant.spriteSource == SpriteSource::atlas) {
+            generateAtlas(textureUploads);
+        }
+        else if (variant.sheetMode != SheetMode::single) {
+            generateSheets(textureUploads);
+        }
+        textureUploads.submit();
+        prepareFrameTable();
+        updatePushConstants();
         setupDescriptorSetLayout();
         preparePipelines();
         setupDescriptorPool();
         setupDescriptorSet();
+        if (gpuSimulation && settings.timelineSemaphores) {
+            computeSimulation.reset(new ComputeSimulation());
+            computeSimulation->prepare(vulkanDevice, &timelines.compute, &timelines.frame, pipelineCache,
+                loadShader(getAssetPath() + "shaders/bunnymark/simulate.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT),
+                loadShader(getAssetPath() + "shaders/bunnymark/spawn.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT), simulation, meshIndexCount);
+        }
+        else if (gpuSimulation) {
+#if defined(VK_USE_PLATFORM_ANDROID_KHR)
+            LOGD("GPU simulation needs timeline semaphores, simulating on the CPU");
+#else
+            std::cout << "GPU simulation needs timeline semaphores, simulating on the CPU" << std::endl;
+#endif
+        }
+        if (settings.renderThread && !settings.timelineSemaphores) {
+            // Slot 0 is filled first and signaled by the first frame, the other slots start out free
+            for (uint32_t i = 0; i < renderSlots; i++) {
+                VkFenceCreateInfo fenceInfo = vks::initializers::fenceCreateInfo(i > 0 ? VK_FENCE_CREATE_SIGNALED_BIT : 0);
+                VK_CHECK(vkCreateFence(device, &fenceInfo, nullptr, &slotFences[i]));
+            }
+        }
+        simulationExtent = glm::vec2((float)width, (float)height);
+        if (startupBunnies > 0) {
+            auto tStart = std::chrono::high_resolution_clock::now();
+            addBunnies(startupBunnies);
+            auto tEnd = std::chrono::high_resolution_clock::now();
+            double ms = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+#if defined(VK_USE_PLATFORM_ANDROID_KHR)
+            LOGD("Spawned %d bunnies in %.2f ms", startupBunnies, ms);
+#else
+            std::cout << "Spawned " << startupBunnies << " bunnies in " << ms << " ms" << std::endl;
+#endif
+        }
         prepared = true;
     }
 
     virtual void render()
     {
-        if (prepared) draw();
-        update(frameDeltaTime);
+        if (settings.renderThread) {
+            // Drawing happens on the render thread, the simulation fills the instance slot of the next published frame
+            update(frameDeltaTime);
+            return;
+        }
+        simulationExtent = glm::vec2((float)width, (float)height);
+        if (textureStreamer) {
+            updateStreaming();
+        }
+        // Low-latency pacing samples input right before the frame is needed, simulate it into this frame instead of the next one
+        if (framePacer.lowLatency) {
+            update(frameDeltaTime);
+            if (prepared) draw();
+        }
+        else {
+            if (prepared) draw();
+            update(frameDeltaTime);
+        }
     }
 
     virtual void viewChanged()
     {
     }
 
+    virtual void keyPressed(uint32_t key)
+    {
+#if defined(_WIN32) || defined(VK_USE_PLATFORM_XCB_KHR)
+        // simulate.comp writes one instance layout, only the alpha mode can change
+        if (computeSimulation && key != KEY_F5) {
+            return;
+        }
+        ShaderVariant v = variant;
+        switch (key) {
+        case KEY_F2:
+            v.instanceFormat = (v.instanceFormat == InstanceFormat::full) ? InstanceFormat::quantized : InstanceFormat::full;
+            break;
+        case KEY_F3:
+            v.transform = (v.transform == TransformMode::matrix) ? TransformMode::angle : TransformMode::matrix;
+            break;
+        case KEY_F4:
+            if (v.sheetMode != SheetMode::single) {
+                return;
+            }
+            v.uvSource = (v.uvSource == UvSource::perDraw) ? UvSource::perInstance : UvSource::perDraw;
+            break;
+        case KEY_F5:
+            // blend, discard, depth, depth with blended edges
+            v.alphaMode = (AlphaMode)(((uint32_t)v.alphaMode + 1) % 4);
+            break;
+        default:
+            return;
+        }
+        setVariant(v);
+#endif
+    }
+
+    virtual void windowResized()
+    {
+        // Command buffers are rebuilt after a resize and pick up the new values
+        updatePushConstants();
+    }
+
     virtual void onUpdateUIOverlay(vks::UIOverlay* overlay)
     {
         static uint32_t lastCount = -1;
@@ -550,6 +2666,39 @@ public:
             sprintf(str, "%d\nBUNNIES", bunnyCount);
         }
         overlay->text(str);
+        if (churnRate > 0.f) {
+            overlay->text("%.1f%% CHURN", churnRate);
+        }
+        if (simulation.rotate || simulation.scale) {
+            overlay->text("%s%s", simulation.rotate ? "ROTATE " : "", simulation.scale ? "SCALE" : "");
+        }
+        if (computeSimulation) {
+            overlay->text("SIM %s%s%s%s %.1fM/S", simulation.gravity ? "GRAVITY " : "", simulation.restitution ? "RESTITUTION " : "",
+                simulation.kick ? "KICK " : "", computeSimulation->async() ? "ASYNC COMPUTE" : "GRAPHICS QUEUE", simulationThroughput);
+            if (computeSimulation->timed()) {
+                // Share of the step that ran while the graphics queue drew the previous one
+                overlay->text("STEP %.2f MS %.0f%% OVERLAP", computeSimulation->stepMs(), computeSimulation->overlap() * 100.0);
+            }
+        }
+        else {
+            overlay->text("SIM %s%s%sX%d %.1fM/S", simulation.gravity ? "GRAVITY " : "", simulation.restitution ? "RESTITUTION " : "",
+                simulation.kick ? "KICK " : "", simulationLanes(simulation.simdWidth), simulationThroughput);
+        }
+        const char* alphaModes[] = { "BLEND", "DISCARD", "DEPTH", "DEPTH+BLEND" };
+        overlay->text("%s %s %s %s",
+            (variant.instanceFormat == InstanceFormat::full) ? "FULL" : "QUANTIZED",
+            (variant.transform == TransformMode::matrix) ? "CPU" : "GPU",
+            (variant.uvSource == UvSource::perDraw) ? "UV/DRAW" : "UV/INSTANCE",
+            alphaModes[(uint32_t)variant.alphaMode]);
+        if (variant.spriteSource == SpriteSource::atlas) {
+            overlay->text("ATLAS %d FRAMES %d PAGES", (int)spriteFrames.size(), atlasPages);
+        }
+        else if (variant.sheetMode != SheetMode::single) {
+            overlay->text("%d SHEETS %s", sheetCount, (variant.sheetMode == SheetMode::array) ? "ARRAY" : "BINDLESS");
+        }
+        if (meshTrimmed) {
+            overlay->text("MESH %d VERTS %.0f%% AREA", meshVertices, meshCoverage[(variant.uvSource == UvSource::perDraw) ? 0 : 1] * 100.f);
+        }
     }
 };
 
@@ -590,4 +2739,21 @@ void android_main(android_app* state)
     app->renderLoop();
     delete (app);
 }
+
+#elif defined(VK_USE_PLATFORM_XCB_KHR)
+// Linux (XCB) entry point
+VulkanDemo* app;
+int main(const int argc, const char* argv[])
+{
+    for (int i = 0; i < argc; i++) {
+        VulkanDemo::args.push_back(argv[i]);
+    };
+    app = new VulkanDemo();
+    app->initVulkan();
+    app->setupWindow();
+    app->prepare();
+    app->renderLoop();
+    delete (app);
+    return 0;
+}
 #endif
@@ -1,5 +1,7 @@
 #version 450
 
+layout (constant_id = 3) const int ALPHA_MODE = 0;	// 0: blend, 1: alpha test, 2: edges dropped by the alpha test
+
 layout (binding = 1) uniform sampler2D uTexture;
 
 layout (location = 0) in vec2 inTexcoord;
@@ -9,4 +11,11 @@ layout (location = 0) out vec4 outColor;
 void main() 
 {
 	outColor = texture(uTexture, inTexcoord);
+	if (ALPHA_MODE == 1 && outColor.a < 0.5) {
+		discard;
+	}
+	// Opaque texels are already drawn by the alpha tested pass, fully transparent ones would only cost blending
+	if (ALPHA_MODE == 2 && (outColor.a >= 0.5 || outColor.a == 0.0)) {
+		discard;
+	}
 }
\ No newline at end of file
@@ -1,18 +1,87 @@
 #version 450 core
 
+// Variant selection, see ShaderVariant in bunnymark.cpp
+layout (constant_id = 0) const int INSTANCE_FORMAT = 0;	// 0: 32 bit float, 1: 16 bit snorm
+layout (constant_id = 1) const int TRANSFORM_MODE = 0;	// 0: scale rotation matrix, 1: angle and scale
+layout (constant_id = 2) const int UV_SOURCE = 0;		// 0: per draw, 1: frame index per instance
+layout (constant_id = 4) const int SHEET_MODE = 0;		// 0: single texture, 1: texture array, 2: descriptor indexing
+layout (constant_id = 5) const int SPRITE_SOURCE = 0;	// 0: bunny frames in the push constants, 1: atlas frame table
+
+// Ranges of the snorm instance format
+const float POSITION_RANGE = 4096.0;
+const float ROTATION_RANGE = 3.14159265;
+const float SCALE_RANGE = 2.0;
+const float SNORM_MAX = 32767.0;
+
+const int FRAME_COUNT = 5;
+
+// Sprite mesh corner relative to the sprite center, texcoords in the texture (per draw) or in the frame rectangle (per instance)
 layout (location = 0) in vec4 inPositionTexcoord;
-layout (location = 1) in vec4 inSpriteScaleRotation;
-layout (location = 2) in vec2 inSpritePosition;
+// matrix: mat2, angle: position, rotation, scale
+layout (location = 1) in vec4 inInstanceA;
+// matrix: position and frame, angle: frame
+layout (location = 2) in vec4 inInstanceB;
 
-layout (binding = 0) uniform UBO {
-	mat4 projection;
-} ubo;
+layout (push_constant) uniform PushConstants {
+	vec2 scale;
+	vec2 translate;
+	vec4 frames[FRAME_COUNT];
+	// Depth of the first instance of the draw and the step between instances, zero unless depth tested
+	vec2 depth;
+} pushConstants;
+
+// Atlas frames, see SpriteFrame in bunnymark.cpp
+struct SpriteFrame {
+	vec4 rect;
+	vec2 size;
+	float page;
+	float padding;
+};
+layout (std430, binding = 2) readonly buffer FrameTable {
+	SpriteFrame frames[];
+} frameTable;
 
 layout(location = 0) out vec2 outTexcoord;
+// Sprite sheet of the instance, only read by the multi-sheet fragment shaders
+layout(location = 1) flat out int outSheet;
 
 void main()
 {
-	outTexcoord = inPositionTexcoord.zw;
-	vec2 position = inPositionTexcoord.xy * mat2(inSpriteScaleRotation.xyzw) + inSpritePosition;
-	gl_Position = ubo.projection * vec4(position, 0.0, 1.0);
+	mat2 scaleRotation;
+	vec2 spritePosition;
+	float frame;
+	if (TRANSFORM_MODE == 0) {
+		scaleRotation = mat2(inInstanceA.xyzw);
+		spritePosition = (INSTANCE_FORMAT == 0) ? inInstanceB.xy : inInstanceB.xy * POSITION_RANGE;
+		frame = inInstanceB.z;
+	} else {
+		vec4 instance = (INSTANCE_FORMAT == 0) ? inInstanceA : inInstanceA * vec4(POSITION_RANGE, POSITION_RANGE, ROTATION_RANGE, SCALE_RANGE);
+		float s = sin(instance.z) * instance.w;
+		float c = cos(instance.z) * instance.w;
+		scaleRotation = mat2(c, -s, s, c);
+		spritePosition = instance.xy;
+		frame = inInstanceB.x;
+	}
+
+	vec2 corner = inPositionTexcoord.xy;
+	if (UV_SOURCE == 0) {
+		outTexcoord = inPositionTexcoord.zw;
+		outSheet = 0;
+	} else if (SPRITE_SOURCE == 1) {
+		// Atlas frames differ in size, only the corner position within the frame is taken from the vertex buffer
+		int sprite = int(round((INSTANCE_FORMAT == 0) ? frame : frame * SNORM_MAX));
+		SpriteFrame spriteFrame = frameTable.frames[sprite];
+		corner = (inPositionTexcoord.zw - 0.5) * spriteFrame.size;
+		outTexcoord = spriteFrame.rect.xy + inPositionTexcoord.zw * spriteFrame.rect.zw;
+		outSheet = int(spriteFrame.page);
+	} else {
+		// Quantized frame indices are stored as raw integers, with multiple sheets the index is frame + sheet * FRAME_COUNT
+		int sprite = int(round((INSTANCE_FORMAT == 0) ? frame : frame * SNORM_MAX));
+		vec4 rect = pushConstants.frames[sprite % FRAME_COUNT];
+		outTexcoord = rect.xy + inPositionTexcoord.zw * rect.zw;
+		outSheet = (SHEET_MODE == 0) ? 0 : sprite / FRAME_COUNT;
+	}
+
+	vec2 position = corner * scaleRotation + spritePosition;
+	gl_Position = vec4(position * pushConstants.scale + pushConstants.translate, pushConstants.depth.x - float(gl_InstanceIndex) * pushConstants.depth.y, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,23 @@
+#version 450
+
+layout (constant_id = 3) const int ALPHA_MODE = 0;	// 0: blend, 1: alpha test, 2: edges dropped by the alpha test
+
+// All sprite sheets as layers of one texture, the fallback when descriptor indexing isn't available
+layout (binding = 1) uniform sampler2DArray uSheets;
+
+layout (location = 0) in vec2 inTexcoord;
+layout (location = 1) flat in int inSheet;
+
+layout (location = 0) out vec4 outColor;
+
+void main() 
+{
+	outColor = texture(uSheets, vec3(inTexcoord, float(inSheet)));
+	if (ALPHA_MODE == 1 && outColor.a < 0.5) {
+		discard;
+	}
+	// Opaque texels are already drawn by the alpha tested pass, fully transparent ones would only cost blending
+	if (ALPHA_MODE == 2 && (outColor.a >= 0.5 || outColor.a == 0.0)) {
+		discard;
+	}
+}
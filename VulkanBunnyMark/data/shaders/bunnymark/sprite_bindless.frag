@@ -0,0 +1,25 @@
+#version 450
+
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout (constant_id = 3) const int ALPHA_MODE = 0;	// 0: blend, 1: alpha test, 2: edges dropped by the alpha test
+
+// One descriptor per sprite sheet (VK_EXT_descriptor_indexing), the sheet varies within a draw
+layout (binding = 1) uniform sampler2D uSheets[];
+
+layout (location = 0) in vec2 inTexcoord;
+layout (location = 1) flat in int inSheet;
+
+layout (location = 0) out vec4 outColor;
+
+void main() 
+{
+	outColor = texture(uSheets[nonuniformEXT(inSheet)], inTexcoord);
+	if (ALPHA_MODE == 1 && outColor.a < 0.5) {
+		discard;
+	}
+	// Opaque texels are already drawn by the alpha tested pass, fully transparent ones would only cost blending
+	if (ALPHA_MODE == 2 && (outColor.a >= 0.5 || outColor.a == 0.0)) {
+		discard;
+	}
+}
@@ -0,0 +1,72 @@
+import sys
+import os
+import re
+import glob
+import struct
+import subprocess
+import tempfile
+import shutil
+
+# Compiles every shader below the shader directory to SPIR-V and writes the code as constexpr arrays
+# to a C++ header included by base/ShaderRegistry.hpp. Shaders are named by their path relative to
+# the shader directory with a .spv suffix, the same name loadShader() is given for the file on disk.
+
+if len(sys.argv) < 3:
+	sys.exit("Usage: embedshaders.py <shader directory> <output header> [glslangValidator]")
+
+if not os.path.exists(sys.argv[1]):
+	sys.exit("%s is not a valid directory" % sys.argv[1])
+
+path = sys.argv[1]
+output = sys.argv[2]
+glslang = sys.argv[3] if len(sys.argv) > 3 else "glslangValidator"
+
+shaderfiles = []
+for root, dirs, files in os.walk(path):
+	for exts in ('*.vert', '*.frag', '*.comp', '*.geom', '*.tesc', '*.tese'):
+		shaderfiles.extend(glob.glob(os.path.join(root, exts)))
+shaderfiles.sort()
+
+tempdir = tempfile.mkdtemp()
+arrays = []
+entries = []
+failedshaders = []
+for shaderfile in shaderfiles:
+	name = os.path.relpath(shaderfile, path).replace(os.sep, "/") + ".spv"
+	spvfile = os.path.join(tempdir, "shader.spv")
+	if subprocess.call([glslang, "-V", shaderfile, "-o", spvfile]) != 0:
+		failedshaders.append(shaderfile)
+		continue
+	with open(spvfile, "rb") as f:
+		code = f.read()
+	words = struct.unpack("<%dI" % (len(code) // 4), code)
+	identifier = "spv_" + re.sub("[^0-9A-Za-z]", "_", name[:-len(".spv")])
+	lines = []
+	for i in range(0, len(words), 8):
+		lines.append("    " + ", ".join("0x%08x" % word for word in words[i:i + 8]) + ",")
+	arrays.append("constexpr uint32_t %s[] = {\n%s\n};\n" % (identifier, "\n".join(lines)))
+	entries.append("    { \"%s\", %s, sizeof(%s) }," % (name, identifier, identifier))
+shutil.rmtree(tempdir)
+
+if len(failedshaders) > 0:
+	print("ERROR: %d shader(s) could not be compiled:\n" % len(failedshaders))
+	for failedshader in failedshaders:
+		print("\t" + failedshader)
+	sys.exit(1)
+
+header = "// Generated by data/shaders/embedshaders.py, do not edit\n\n"
+header += "namespace vks {\nnamespace shaders {\n\n"
+header += "\n".join(arrays)
+header += "\nconstexpr Shader embedded[] = {\n%s\n};\n\n}\n}\n" % "\n".join(entries)
+
+# Unchanged headers are left alone so they don't trigger a rebuild
+if os.path.exists(output):
+	with open(output, "r") as f:
+		if f.read() == header:
+			sys.exit(0)
+outputdir = os.path.dirname(output)
+if outputdir and not os.path.exists(outputdir):
+	os.makedirs(outputdir)
+with open(output, "w") as f:
+	f.write(header)
+print("Embedded %d shader(s) in %s" % (len(entries), output))